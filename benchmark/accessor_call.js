@@ -0,0 +1,16 @@
+// Reads and writes a native accessor (Timer.prototype.repeat) in a tight loop.
+var Timer = process.binding('timer').Timer;
+
+var timer = new Timer();
+var n = 5e6;
+var sum = 0;
+
+var start = Date.now();
+for (var i = 0; i < n; i++) {
+  timer.repeat = i;
+  sum += timer.repeat;
+}
+var elapsed = Date.now() - start;
+
+console.log('%d accessor get/set pairs in %d ms (%d ns/pair)',
+            n, elapsed, Math.round(elapsed * 1e6 / n));
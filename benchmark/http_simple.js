@@ -39,6 +39,7 @@ var server = http.createServer(function (req, res) {
   var command = commands[1];
   var body = "";
   var arg = commands[2];
+  var n_chunks = parseInt(commands[3], 10);
   var status = 200;
 
   if (command == "bytes") {
@@ -81,11 +82,24 @@ var server = http.createServer(function (req, res) {
     body = "not found\n";
   }
 
-  var content_length = body.length.toString();
+  if (n_chunks > 0) {
+    res.writeHead(status, { "Content-Type": "text/plain",
+                            "Transfer-Encoding": "chunked" });
+    // send body in chunks
+    var len = body.length;
+    var step = Math.floor(len / n_chunks) || 1;
 
-  res.writeHead(status, { "Content-Type": "text/plain",
-                          "Content-Length": content_length });
-  res.end(body);
+    for (var i = 0, n = (n_chunks - 1); i < n; ++i) {
+      res.write(body.slice(i * step, i * step + step));
+    }
+    res.end(body.slice((n_chunks - 1) * step));
+  } else {
+    var content_length = body.length.toString();
+
+    res.writeHead(status, { "Content-Type": "text/plain",
+                            "Content-Length": content_length });
+    res.end(body);
+  }
 
 });
 
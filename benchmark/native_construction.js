@@ -0,0 +1,43 @@
+// Measures how fast each native class can be constructed from script.
+var SlowBuffer = require('buffer').SlowBuffer;
+var Timer = process.binding('timer').Timer;
+var IOWatcher = process.binding('io_watcher').IOWatcher;
+var StatWatcher = process.binding('fs').StatWatcher;
+var HTTPParser = process.binding('http_parser').HTTPParser;
+
+try {
+  var crypto = process.binding('crypto');
+} catch (e) {
+  var crypto = null;
+}
+
+var n = 2e5;
+
+function run(name, construct) {
+  var start = Date.now();
+  for (var i = 0; i < n; i++) {
+    construct();
+  }
+  var elapsed = Date.now() - start;
+
+  console.log('%s: %d constructions in %d ms (%d ns each)',
+              name, n, elapsed, Math.round(elapsed * 1e6 / n));
+}
+
+run('Timer', function() { return new Timer(); });
+run('IOWatcher', function() { return new IOWatcher(); });
+run('StatWatcher', function() { return new StatWatcher(); });
+run('HTTPParser', function() { return new HTTPParser('request'); });
+run('SlowBuffer', function() { return new SlowBuffer(10); });
+
+if (crypto) {
+  run('SecureContext', function() { return new crypto.SecureContext(); });
+  run('Hash', function() { return new crypto.Hash('sha1'); });
+  run('Hmac', function() { return new crypto.Hmac(); });
+  run('Cipher', function() { return new crypto.Cipher(); });
+  run('Decipher', function() { return new crypto.Decipher(); });
+  run('Sign', function() { return new crypto.Sign(); });
+  run('Verify', function() { return new crypto.Verify(); });
+} else {
+  console.log('crypto: not compiled with openssl, skipped');
+}
@@ -0,0 +1,150 @@
+// Runs one HTTP server process per CPU, each listening on the same port
+// through its own SO_REUSEPORT socket, and reports how many connections the
+// kernel handed to each of them.
+//
+//   node benchmark/reuseport_cluster.js [connections] [workers]
+//
+// Given a number of connections, the master opens them itself (50 at a
+// time), prints the per-worker accept counts and exits.  Without one the
+// workers keep running and print their counts every second, for use with ab
+// or another load generator.
+
+var net = require('net');
+var http = require('http');
+var os = require('os');
+var spawn = require('child_process').spawn;
+
+var port = parseInt(process.env.PORT || 8000);
+var concurrency = 50;
+
+if (process.argv[2] == 'worker') {
+  port = parseInt(process.argv[3]);
+  worker();
+} else {
+  master(parseInt(process.argv[2] || 0),
+         parseInt(process.argv[3] || os.cpus().length));
+}
+
+
+function worker() {
+  var accepted = 0;
+  var reported = 0;
+
+  var server = http.createServer(function(req, res) {
+    res.writeHead(200, { 'Content-Type': 'text/plain',
+                         'Content-Length': 2 });
+    res.end('ok');
+  });
+  server.reusePort = true;
+
+  server.on('connection', function() {
+    accepted++;
+  });
+
+  server.listen(port, function() {
+    console.log('listening');
+  });
+
+  setInterval(function() {
+    if (accepted != reported) {
+      reported = accepted;
+      console.log('accepted ' + accepted);
+    }
+  }, 1000);
+
+  // The master closes our stdin to ask for the final count.
+  var stdin = process.openStdin();
+  stdin.on('end', function() {
+    console.log('total ' + accepted);
+    process.exit(0);
+  });
+}
+
+
+function master(connections, nworkers) {
+  var workers = [];
+  var listening = 0;
+  var reported = 0;
+
+  for (var i = 0; i < nworkers; i++) {
+    workers.push(startWorker(i));
+  }
+
+  function startWorker(id) {
+    var child = spawn(process.execPath, [__filename, 'worker', port],
+                      undefined, [-1, -1, 2]);
+    var w = { id: id, pid: child.pid, child: child, total: null };
+    var buffered = '';
+
+    // The workers only print ASCII.  Decoded by hand since toString() on a
+    // slice of the read pool still applies the slice's offset twice.
+    child.stdout.on('data', function(d) {
+      for (var i = 0; i < d.length; i++) buffered += String.fromCharCode(d[i]);
+      var lines = buffered.split('\n');
+      buffered = lines.pop();
+      lines.forEach(function(line) { onLine(w, line); });
+    });
+    child.on('exit', function(code) {
+      if (w.total === null) {
+        console.error('worker %d (pid %d) exited with %d', id, w.pid, code);
+        process.exit(1);
+      }
+    });
+    return w;
+  }
+
+  function onLine(w, line) {
+    var m = /^(\w+)(?: (\d+))?$/.exec(line);
+    if (!m) {
+      console.log('worker %d: %s', w.id, line);
+    } else if (m[1] == 'listening') {
+      if (++listening == nworkers) {
+        console.log('%d workers listening on port %d', nworkers, port);
+        if (connections) generateLoad();
+      }
+    } else if (m[1] == 'accepted') {
+      if (!connections) console.log('worker %d: %s', w.id, m[2]);
+    } else if (m[1] == 'total') {
+      w.total = parseInt(m[2]);
+      if (++reported == nworkers) report();
+    }
+  }
+
+  function generateLoad() {
+    var started = 0;
+    var finished = 0;
+    var start = Date.now();
+
+    function connect() {
+      started++;
+      var c = net.createConnection(port, '127.0.0.1');
+      c.on('connect', function() {
+        c.end('GET / HTTP/1.0\r\n\r\n');
+      });
+      c.on('error', function(e) {
+        console.error('client: %s', e.message);
+      });
+      c.on('close', function() {
+        if (++finished == connections) {
+          var elapsed = Date.now() - start;
+          console.log('%d connections in %d ms', connections, elapsed);
+          workers.forEach(function(w) { w.child.stdin.end(); });
+        } else if (started < connections) {
+          connect();
+        }
+      });
+    }
+
+    for (var i = 0; i < concurrency && i < connections; i++) connect();
+  }
+
+  function report() {
+    var total = 0;
+    workers.forEach(function(w) { total += w.total; });
+    workers.forEach(function(w) {
+      var share = total ? (100 * w.total / total).toFixed(1) : '0.0';
+      console.log('worker %d (pid %d): %d accepted, %s',
+                  w.id, w.pid, w.total, share + '%');
+    });
+  }
+}
@@ -1,26 +1,115 @@
+// Measures process startup: with an empty script, and with a script that
+// loads a few hundred generated modules, both without and with a warm
+// NODE_COMPILE_CACHE.  The modules and the cache live in a scratch directory
+// under $TMPDIR that is removed once the runs are done.
 var spawn = require('child_process').spawn,
+    fs = require('fs'),
     path = require('path'),
     emptyJsFile = path.join(__dirname, '../test/fixtures/semicolon.js'),
-    starts = 100,
-    i = 0,
-    start;
-
-function startNode() {
-  var node = spawn(process.execPath || process.argv[0], [emptyJsFile]);
-  node.on('exit', function(exitCode) {
-    if (exitCode !== 0) {
-      throw new Error('Error during node startup');
-    }
+    tmpDir = path.join(process.env.TMPDIR || '/tmp',
+                       'node-startup-bench-' + process.pid),
+    cacheDir = path.join(tmpDir, 'cache'),
+    moduleCount = 300,
+    starts = 20;
+
+function mkdirp(dir) {
+  try {
+    fs.mkdirSync(dir, 0755);
+  } catch (e) {
+    if (e.code !== 'EEXIST') throw e;
+  }
+}
 
-    i++;
-    if (i < starts) {
-      startNode();
-    } else{
-      var duration = +new Date - start;
-      console.log('Started node %d times in %s ms. %d ms / start.', starts, duration, duration / starts);
+function rmdirContents(dir) {
+  fs.readdirSync(dir).forEach(function(name) {
+    var file = path.join(dir, name);
+    if (fs.statSync(file).isDirectory()) {
+      rmdirContents(file);
+      fs.rmdirSync(file);
+    } else {
+      fs.unlinkSync(file);
     }
   });
 }
 
-start = +new Date;
-startNode();
+// Each module carries a bit of realistic code so that parsing dominates.
+function writeModules() {
+  mkdirp(tmpDir);
+  rmdirContents(tmpDir);
+  mkdirp(cacheDir);
+
+  var body = [];
+  for (var i = 0; i < 40; i++) {
+    body.push('exports.f' + i + ' = function(a, b) {\n' +
+              '  var r = [];\n' +
+              '  for (var k in a) {\n' +
+              '    if (a.hasOwnProperty(k) && typeof a[k] === "string") {\n' +
+              '      r.push(k + "=" + a[k].replace(/\\s+/g, " ") + b);\n' +
+              '    }\n' +
+              '  }\n' +
+              '  return r.join("&");\n' +
+              '};');
+  }
+  body = body.join('\n');
+
+  var main = [];
+  for (var i = 0; i < moduleCount; i++) {
+    var name = 'm' + i + '.js';
+    fs.writeFileSync(path.join(tmpDir, name), body + '\n');
+    main.push('require("./' + name + '");');
+  }
+  fs.writeFileSync(path.join(tmpDir, 'main.js'), main.join('\n') + '\n');
+}
+
+function run(name, script, env, cb) {
+  var i = 0;
+  var start = Date.now();
+
+  function startNode() {
+    var node = spawn(process.execPath || process.argv[0], [script],
+                     { env: env });
+    node.on('exit', function(exitCode) {
+      if (exitCode !== 0) {
+        throw new Error('Error during node startup');
+      }
+
+      i++;
+      if (i < starts) {
+        startNode();
+      } else {
+        var duration = Date.now() - start;
+        console.log('%s: started node %d times in %d ms. %d ms / start.',
+                    name, starts, duration, duration / starts);
+        cb();
+      }
+    });
+  }
+  startNode();
+}
+
+function envWith(extra) {
+  var env = {};
+  for (var k in process.env) env[k] = process.env[k];
+  for (var k in extra) env[k] = extra[k];
+  return env;
+}
+
+writeModules();
+var mainFile = path.join(tmpDir, 'main.js');
+var noCache = envWith({});
+delete noCache.NODE_COMPILE_CACHE;
+var withCache = envWith({ NODE_COMPILE_CACHE: cacheDir });
+
+run('empty', emptyJsFile, noCache, function() {
+  run(moduleCount + ' modules', mainFile, noCache, function() {
+    // The first start populates the cache; the timed ones all hit it.
+    spawn(process.execPath, [mainFile], { env: withCache })
+      .on('exit', function() {
+        run(moduleCount + ' modules, compile cache', mainFile, withCache,
+            function() {
+              rmdirContents(tmpDir);
+              fs.rmdirSync(tmpDir);
+            });
+      });
+  });
+});
@@ -0,0 +1,34 @@
+// Measures Buffer.write throughput for short and 1 MB strings, ASCII and not.
+var Buffer = require('buffer').Buffer;
+
+function run(name, str, encoding, iterations) {
+  var buf = new Buffer(Buffer.byteLength(str, encoding));
+  var bytes = 0;
+
+  var start = Date.now();
+  for (var i = 0; i < iterations; i++) {
+    bytes += buf.write(str, 0, encoding);
+  }
+  var elapsed = Date.now() - start || 1;
+
+  console.log('%s %s: %d writes in %d ms (%d MB/s)',
+              name, encoding, iterations, elapsed,
+              Math.round(bytes / 1024 / 1024 / (elapsed / 1000)));
+}
+
+function repeat(s, length) {
+  while (s.length < length) s += s;
+  return s.slice(0, length);
+}
+
+var shortAscii = 'GET /index.html HTTP/1.1';
+var shortMixed = 'café ☃ naïve';
+var longAscii = repeat('The quick brown fox jumps over the lazy dog. ', 1 << 20);
+var longMixed = repeat('The quick brown fox ☃ jumps over the lazy dog. ', 1 << 20);
+
+['utf8', 'ascii'].forEach(function(encoding) {
+  run('short ascii', shortAscii, encoding, 1e5);
+  run('short mixed', shortMixed, encoding, 1e5);
+  run('1MB ascii', longAscii, encoding, 200);
+  run('1MB mixed', longMixed, encoding, 200);
+});
@@ -0,0 +1,31 @@
+// Measures vm contexts per second: runInNewContext copies the sandbox in and
+// out, runInSandbox proxies it.  Pass a number to change the sandbox size.
+var vm = require('vm');
+
+var keys = parseInt(process.argv[2], 10) || 10;
+var iterations = 20000;
+
+function sandbox() {
+  var s = { items: [1, 2, 3] };
+  for (var i = 0; i < keys; i++) s['key' + i] = 'value' + i;
+  return s;
+}
+
+function run(name, fn, code) {
+  var start = Date.now();
+  for (var i = 0; i < iterations; i++) {
+    fn(code, sandbox());
+  }
+  var elapsed = Date.now() - start || 1;
+
+  console.log('%s (%d keys): %d contexts in %d ms (%d/s)',
+              name, keys, iterations, elapsed,
+              Math.round(iterations / (elapsed / 1000)));
+}
+
+var template = 'out = "<ul>" + items.map(function(i) {' +
+               '  return "<li>" + key0 + i + "</li>";' +
+               '}).join("") + "</ul>"';
+
+run('runInNewContext', vm.runInNewContext, template);
+run('runInSandbox', vm.runInSandbox, template);
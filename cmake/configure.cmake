@@ -105,7 +105,7 @@ add_definitions(
   -DX_STACKSIZE=65536
   -D_LARGEFILE_SOURCE
   -D_FILE_OFFSET_BITS=64
-  -DEV_MULTIPLICITY=0
+  -DEV_MULTIPLICITY=1
   -D_FORTIFY_SOURCE=2
   )
 
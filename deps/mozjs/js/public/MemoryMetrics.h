@@ -185,8 +185,6 @@ struct RuntimeStats
     DestroyNameCallback destroyNameCb;
 };
 
-#ifdef JS_THREADSAFE
-
 extern JS_PUBLIC_API(bool)
 CollectRuntimeStats(JSRuntime *rt, RuntimeStats *rtStats);
 
@@ -194,8 +192,6 @@ extern JS_PUBLIC_API(bool)
 GetExplicitNonHeapForRuntime(JSRuntime *rt, int64_t *amount,
                              JSMallocSizeOfFun mallocSizeOf);
 
-#endif /* JS_THREADSAFE */
-
 extern JS_PUBLIC_API(size_t)
 SystemCompartmentCount(const JSRuntime *rt);
 
@@ -48,8 +48,6 @@
 
 #include "jsobjinlines.h"
 
-#ifdef JS_THREADSAFE
-
 namespace JS {
 
 using namespace js;
@@ -347,5 +345,3 @@ GetExplicitNonHeapForRuntime(JSRuntime *rt, int64_t *amount,
 }
 
 } // namespace JS
-
-#endif // JS_THREADSAFE
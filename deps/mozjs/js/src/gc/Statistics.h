@@ -89,6 +89,12 @@ struct Statistics {
         counts[s]++;
     }
 
+    /* Microseconds spent in |phase| so far during the current GC. */
+    uint64_t phaseTime(Phase phase) const {
+        JS_ASSERT(phase < PHASE_LIMIT);
+        return phaseTimes[phase];
+    }
+
   private:
     JSRuntime *runtime;
 
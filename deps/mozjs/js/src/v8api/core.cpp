@@ -1,29 +1,72 @@
 #include "v8-internal.h"
+#include "prmjtime.h"
+#include "jscntxt.h"
+#include "jscompartment.h"
+#include "jsgc.h"
+#include "jsprf.h"
+#include "js/MemoryMetrics.h"
+
+#include <limits.h>
+#include <new>
+#if defined(__linux__)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#endif
 
 namespace v8 { namespace internal {
 
 const int KB = 1024;
 const int MB = 1024 * 1024;
-static JSRuntime *gRuntime = 0;
+
+V8_THREAD_LOCAL IsolateState *gCurrentIsolate = 0;
+
 JSRuntime *rt() {
-  if (!gRuntime) {
+  IsolateState *state = isolate();
+  if (!state->runtime) {
     V8::Initialize();
   }
-  return gRuntime;
+  return state->runtime;
 }
 
-static JSContext *gRootContext = 0;
 JSContext *cx() {
-  if (!gRootContext) {
+  IsolateState *state = isolate();
+  if (!state->rootContext) {
     V8::Initialize();
   }
-  return gRootContext;
+  return state->rootContext;
+}
+
+// Standard classes are resolved on first use rather than defined up front,
+// which makes a new context cheap.  Enumeration only has to define them for
+// getOwnPropertyNames; for..in never sees them.
+static JSBool global_enumerate(JSContext *cx, JSObject *obj, JSIterateOp op,
+                               jsval *statep, jsid *idp) {
+  if (op == JSENUMERATE_INIT_ALL && !JS_EnumerateStandardClasses(cx, obj))
+    return JS_FALSE;
+  statep->setMagic(JS_NATIVE_ENUMERATE);
+  return JS_TRUE;
+}
+
+static JSBool global_resolve(JSContext *cx, JSObject *obj, jsid id) {
+  // A prototype brought in from another global (a sandbox) takes precedence
+  // over the builtins it names, as if it had been copied onto this global.
+  JSObject *proto = JS_GetPrototype(obj);
+  if (proto && JS_GetGlobalForObject(cx, proto) != obj) {
+    JSBool found;
+    if (!JS_HasPropertyById(cx, proto, id, &found))
+      return JS_FALSE;
+    if (found)
+      return JS_TRUE;
+  }
+  JSBool resolved;
+  return JS_ResolveStandardClass(cx, obj, id, &resolved);
 }
 
 JSClass global_class = {
-  "global", JSCLASS_GLOBAL_FLAGS,
+  "global", JSCLASS_GLOBAL_FLAGS | JSCLASS_NEW_ENUMERATE,
   JS_PropertyStub, JS_PropertyStub, JS_PropertyStub, JS_StrictPropertyStub,
-  JS_EnumerateStub, JS_ResolveStub, JS_ConvertStub, JS_FinalizeStub,
+  (JSEnumerateOp)global_enumerate, global_resolve, JS_ConvertStub, JS_FinalizeStub,
   JSCLASS_NO_OPTIONAL_MEMBERS
 };
 
@@ -33,78 +76,263 @@ void notImplemented(const char* functionName) {
 #endif
 }
 
-static JSObject* gCompartment = 0;
-static JSCrossCompartmentCall *gCompartmentCall = 0;
-static bool gHasAttemptedInitialization = false;
-static FatalErrorCallback gFatalCallback = 0;
+IsolateState::IsolateState() :
+  runtime(0),
+  rootContext(0),
+  compartment(0),
+  compartmentCall(0),
+  hasAttemptedInitialization(false),
+  fatalCallback(0),
+  prototypeId(JSID_VOID),
+  // Limits set through SetResourceConstraints and SetFlagsFromCommandLine.
+  // These may arrive before the runtime exists, so Initialize applies them
+  // too.  A zero maxMallocBytes or stackLimit means the engine default.
+  maxBytes(64 * MB),
+  maxMallocBytes(0),
+  stackLimit(0),
+  gcMode(JSGC_MODE_GLOBAL),
+  exposeGC(false),
+  // Bytes held outside the GC heap by objects in it, as reported through
+  // AdjustAmountOfExternalAllocatedMemory.
+  externalMemory(0),
+  // What IdleNotification knows about the last collection: the GC heap and
+  // external sizes it left behind, and how long it took in microseconds.
+  bytesAfterGC(0),
+  externalAfterGC(0),
+  gcStart(0),
+  lastGCDuration(0),
+  gcFlags(kNoGCCallbackFlags),
+  handleScope(0),
+  firstSlab(0),
+  currentSlab(0),
+  top(0),
+  persistentSlabs(0),
+  freePersistents(0),
+  weakCallbacksLastGC(0),
+  privateDataMap(0),
+  exnChain(0),
+  contextChain(0)
+{}
 
 bool disposed() {
-  return gHasAttemptedInitialization && !gRuntime;
+  IsolateState *state = isolate();
+  return state->hasAttemptedInitialization && !state->runtime;
 }
+
+// Until memory grows this much past what the last collection left behind,
+// another collection would find little new garbage.
+static const size_t kIdleGCMinGrowth = 256 * 1024;
+
+static void ApplyResourceLimits() {
+  IsolateState *state = isolate();
+  JSRuntime *runtime = state->runtime;
+  JS_ASSERT(runtime);
+  // JSGC_MAX_BYTES may not be lowered below what the heap already holds.
+  uint32_t maxBytes = js::Max(state->maxBytes,
+                              JS_GetGCParameter(runtime, JSGC_BYTES));
+  JS_SetGCParameter(runtime, JSGC_MAX_BYTES, maxBytes);
+  JS_SetGCParameter(runtime, JSGC_MAX_MALLOC_BYTES,
+                    state->maxMallocBytes ? state->maxMallocBytes : maxBytes);
+  JS_SetGCParameter(runtime, JSGC_MODE, state->gcMode);
+
+  uintptr_t limit = state->stackLimit;
+  if (limit) {
+    // V8 takes the lowest usable address; SpiderMonkey wants the distance
+    // from the base of the stack.
+    uintptr_t base = runtime->nativeStackBase;
+#if JS_STACK_GROWTH_DIRECTION > 0
+    size_t quota = limit > base ? limit - base : 1;
+#else
+    size_t quota = limit < base ? base - limit : 1;
+#endif
+    JS_SetNativeStackQuota(runtime, quota);
+  }
+}
+
+// Callbacks registered through Add{Prologue,Epilogue}Callback.
+static void AddGCCallback(GCCallbackList& list, GCPrologueCallback callback,
+                          GCType filter) {
+  GCCallbackEntry entry = { callback, filter };
+  (void) list.append(entry);
+}
+
+static void RemoveGCCallback(GCCallbackList& list, GCPrologueCallback callback) {
+  for (size_t i = 0; i < list.length(); i++) {
+    if (list[i].callback == callback) {
+      list.erase(&list[i]);
+      return;
+    }
+  }
+}
+
+static void CallGCCallbacks(const GCCallbackList& list, GCType type) {
+  for (size_t i = 0; i < list.length(); i++) {
+    if (list[i].filter & type) {
+      list[i].callback(type, isolate()->gcFlags);
+    }
+  }
+}
+
+// The engine phases behind each GCPhase.
+static const js::gcstats::Phase kGCPhases[] = {
+  js::gcstats::PHASE_MARK,
+  js::gcstats::PHASE_SWEEP,
+  js::gcstats::PHASE_SWEEP_OBJECT,
+  js::gcstats::PHASE_SWEEP_STRING,
+  js::gcstats::PHASE_SWEEP_SCRIPT,
+  js::gcstats::PHASE_SWEEP_SHAPE,
+  js::gcstats::PHASE_DISCARD_CODE,
+  js::gcstats::PHASE_DESTROY
+};
+JS_STATIC_ASSERT(JS_ARRAY_LENGTH(kGCPhases) == kGCPhaseCount);
+
+static void TraceRoots(JSTracer* tracer, void* data) {
+  TraceHandles(tracer);
+  TraceObjectInternals(tracer, data);
+}
+
+static JSBool CompartmentCallback(JSContext* cx, JSCompartment* compartment,
+                                  uintN op) {
+  if (op == JSCOMPARTMENT_DESTROY)
+    DestroyWeakHandleTable(compartment);
+  return true;
+}
+
+void IsolateState::DestroyRuntime() {
+  JS_ASSERT(this == isolate());
+  DestroyObjectInternals();
+
+  // Unwind the context scopes
+  Local<Context> ctx;
+  while (!(ctx = Context::GetCurrent()).IsEmpty()) {
+    ctx->Exit();
+  }
+  // Unwind the handle scopes
+  while (handleScope) {
+    handleScope->Destroy();
+  }
+  DestroyWeakHandleTables();
+  DestroyHandles();
+  JS_LeaveCrossCompartmentCall(compartmentCall);
+  compartmentCall = 0;
+  (void) JS_RemoveObjectRoot(rootContext, &compartment);
+  compartment = 0;
+  JS_EndRequest(rootContext);
+  // TODO when we have fixed our leaks, we need to uncomment this line.  It will
+  // assert as long as we are leaking roots...
+  //JS_DestroyContext(rootContext);
+  rootContext = 0;
+  if (runtime)
+    JS_DestroyRuntime(runtime);
+  runtime = 0;
+}
+
+static IsolateState *gDefaultIsolate = 0;
 }
 
 using namespace internal;
 
+IsolateState *internal::DefaultIsolate() {
+  // The first thread to touch the API creates it, before any other thread
+  // can be running an isolate of its own.
+  if (!gDefaultIsolate) {
+    gDefaultIsolate = js::OffTheBooks::new_<IsolateState>();
+  }
+  gCurrentIsolate = gDefaultIsolate;
+  return gDefaultIsolate;
+}
+
+Isolate::Isolate() :
+  mPrevious(NULL),
+  mEntryCount(0),
+  mData(NULL)
+{}
+
+Isolate* Isolate::New() {
+  // Isolates outlive their runtimes, so they can't come from one.
+  return js::OffTheBooks::new_<IsolateState>();
+}
+
+Isolate* Isolate::GetCurrent() {
+  return isolate();
+}
+
+void Isolate::Enter() {
+  IsolateState *self = static_cast<IsolateState*>(this);
+  if (mEntryCount++ > 0) {
+    JS_ASSERT(gCurrentIsolate == self);
+    return;
+  }
+  mPrevious = gCurrentIsolate;
+  gCurrentIsolate = self;
+}
+
+void Isolate::Exit() {
+  JS_ASSERT(gCurrentIsolate == this && mEntryCount > 0);
+  if (--mEntryCount == 0) {
+    gCurrentIsolate = static_cast<IsolateState*>(mPrevious);
+    mPrevious = NULL;
+  }
+}
+
+void Isolate::Dispose() {
+  JS_ASSERT(mEntryCount == 0);
+  JS_ASSERT(this != gDefaultIsolate);
+  {
+    Scope scope(this);
+    if (isolate()->runtime)
+      isolate()->DestroyRuntime();
+  }
+  js::Foreground::delete_(static_cast<IsolateState*>(this));
+}
+
 bool V8::Initialize() {
-  if (gHasAttemptedInitialization)
+  IsolateState *state = isolate();
+  if (state->hasAttemptedInitialization)
     return true;
-  gHasAttemptedInitialization = true;
-  JS_SetCStringsAreUTF8();
-  JS_ASSERT(!gRuntime && !gRootContext && !gCompartment && !gCompartmentCall);
-  gRuntime = JS_NewRuntime(64 * MB);
-  if(!gRuntime)
+  state->hasAttemptedInitialization = true;
+  // Only allowed before the first runtime exists, which is always the
+  // default isolate's.
+  if (state == gDefaultIsolate)
+    JS_SetCStringsAreUTF8();
+  JS_ASSERT(!state->runtime && !state->rootContext && !state->compartment &&
+            !state->compartmentCall);
+  JSRuntime *runtime = JS_NewRuntime(state->maxBytes);
+  if(!runtime)
     return false;
+  state->runtime = runtime;
+  ApplyResourceLimits();
 
-  JSContext *ctx(JS_NewContext(gRuntime, 8192));
+  JSContext *ctx(JS_NewContext(runtime, 8192));
   if (!ctx)
     return false;
   // TODO: look into JSOPTION_NO_SCRIPT_RVAL
   JS_SetOptions(ctx, JSOPTION_VAROBJFIX | JSOPTION_METHODJIT | JSOPTION_DONT_REPORT_UNCAUGHT);
   JS_SetVersion(ctx, JSVERSION_LATEST);
-  JS_SetErrorReporter(ctx, TryCatch::ReportError);
+  JS_SetErrorReporter(ctx, V8::ReportError);
 
   JS_BeginRequest(ctx);
 
-  gRootContext = ctx;
+  state->rootContext = ctx;
 
-  gCompartment = JS_NewCompartmentAndGlobalObject(ctx, &global_class, NULL);
-  if (!gCompartment)
+  state->compartment = JS_NewCompartmentAndGlobalObject(ctx, &global_class, NULL);
+  if (!state->compartment)
     return false;
-  gCompartmentCall = JS_EnterCrossCompartmentCall(ctx, gCompartment);
-  if (!gCompartmentCall)
+  state->compartmentCall = JS_EnterCrossCompartmentCall(ctx, state->compartment);
+  if (!state->compartmentCall)
     return false;
 
-  (void) JS_AddObjectRoot(ctx, &gCompartment);
+  (void) JS_AddObjectRoot(ctx, &state->compartment);
 
-  JS_SetGCCallback(cx(), GCCallback);
-  JS_SetExtraGCRootsTracer(gRuntime, TraceObjectInternals, NULL);
+  JS_SetGCCallback(ctx, GCCallback);
+  JS_SetCompartmentCallback(runtime, CompartmentCallback);
+  JS_SetExtraGCRootsTracer(runtime, TraceRoots, NULL);
   return true;
 }
 
 // TODO: call this
 bool V8::Dispose() {
-  DestroyObjectInternals();
-
-  // Unwind the context scopes
-  Local<Context> ctx;
-  while (!(ctx = Context::GetCurrent()).IsEmpty()) {
-    ctx->Exit();
-  }
-  // Unwind the handle scopes
-  while (HandleScope::sCurrent) {
-    HandleScope::sCurrent->Destroy();
-  }
-  JS_LeaveCrossCompartmentCall(gCompartmentCall);
-  (void) JS_RemoveObjectRoot(gRootContext, &gCompartment);
-  gCompartment = 0;
-  JS_EndRequest(gRootContext);
-  // TODO when we have fixed our leaks, we need to uncomment this line.  It will
-  // assert as long as we are leaking roots...
-  //JS_DestroyContext(gRootContext);
-  gRootContext = 0;
-  if (gRuntime)
-    JS_DestroyRuntime(gRuntime);
-  gRuntime = 0;
+  isolate()->DestroyRuntime();
   JS_ShutDown();
   return true;
 }
@@ -116,27 +344,164 @@ Handle<Value> ThrowException(Handle<Value> exception) {
   return Undefined();
 }
 
-bool V8::IdleNotification() {
-  // XXX Returning true here will tell Node to stop running the GC timer, so
-  //     we're just going to do that for now.
-  return true;
+bool V8::IdleNotification(int hint) {
+  JSRuntime* runtime = rt();
+  uint32_t gcNumber = JS_GetGCParameter(runtime, JSGC_NUMBER);
+
+  // Let the engine run any collection it already wants; doing it now keeps
+  // it out of the next burst of work.
+  JS_MaybeGC(cx());
+  if (JS_GetGCParameter(runtime, JSGC_NUMBER) != gcNumber) {
+    return false;
+  }
+
+  // Nothing much has been allocated since the last collection, so there is
+  // no garbage worth looking for.  Hand the empty chunks back instead.
+  int64_t growth =
+    int64_t(JS_GetGCParameter(runtime, JSGC_BYTES)) - int64_t(isolate()->bytesAfterGC) +
+    isolate()->externalMemory - isolate()->externalAfterGC;
+  if (growth < int64_t(kIdleGCMinGrowth)) {
+    JS_ShrinkGCBuffers(runtime);
+    return true;
+  }
+
+  // A collection would probably outlast the idle period.
+  if (isolate()->lastGCDuration > int64_t(hint) * PRMJ_USEC_PER_MSEC) {
+    return true;
+  }
+
+  if (JS_GetGCParameter(runtime, JSGC_MODE) == JSGC_MODE_COMPARTMENT) {
+    JS_CompartmentGC(cx(), js::GetContextCompartment(cx()));
+  } else {
+    JS_GC(cx());
+  }
+  return false;
 }
 
 HeapStatistics::HeapStatistics() :
   total_heap_size_(0),
   total_heap_size_executable_(0),
   used_heap_size_(0),
-  heap_size_limit_(0)
+  heap_size_limit_(0),
+  number_of_weak_handles_(0),
+  weak_callbacks_last_gc_(0)
 {}
 
+GCStatistics::GCStatistics() :
+  count_(0),
+  total_pause_(0),
+  max_pause_(0),
+  last_pause_(0)
+{
+  memset(phase_times_, 0, sizeof(phase_times_));
+  memset(last_phase_times_, 0, sizeof(last_phase_times_));
+  memset(histogram_, 0, sizeof(histogram_));
+}
+
+namespace internal {
+static void SumMjitCode(JSContext* cx, void* data, JSCompartment* compartment) {
+#ifdef JS_METHODJIT
+  *static_cast<size_t*>(data) += compartment->sizeOfMjitCode();
+#endif
+}
+
+static size_t MallocSizeOf(const void* ptr) {
+#if defined(__linux__)
+  return malloc_usable_size(const_cast<void*>(ptr));
+#elif defined(__APPLE__)
+  return malloc_size(ptr);
+#else
+  return 0;
+#endif
+}
+
+static void* CompartmentName(JSContext* cx, JSCompartment* compartment) {
+  char* name = static_cast<char*>(js::OffTheBooks::malloc_(32));
+  if (!name)
+    return NULL;
+  if (compartment == cx->runtime->atomsCompartment) {
+    strcpy(name, "atoms");
+  } else if (compartment == js::GetObjectCompartment(isolate()->compartment)) {
+    strcpy(name, "main");
+  } else {
+    JS_snprintf(name, 32, "compartment-%p", (void*)compartment);
+  }
+  return name;
+}
+
+static void DestroyCompartmentName(void* name) {
+  js::Foreground::free_(name);
+}
+}
+
 void V8::GetHeapStatistics(HeapStatistics* aHeapStatistics) {
-  size_t limit = JS_GetGCParameter(rt(), JSGC_MAX_BYTES);
-  size_t used = JS_GetGCParameter(rt(), JSGC_BYTES);
+  JSRuntime* runtime = rt();
+  size_t limit = JS_GetGCParameter(runtime, JSGC_MAX_BYTES);
+  size_t used = JS_GetGCParameter(runtime, JSGC_BYTES);
+  size_t total =
+    size_t(JS_GetGCParameter(runtime, JSGC_TOTAL_CHUNKS)) * js::gc::ChunkSize;
+  size_t executable = 0;
+  js::IterateCompartments(cx(), &executable, SumMjitCode);
 
   aHeapStatistics->set_heap_size_limit(limit);
+  aHeapStatistics->set_total_heap_size(total);
+  aHeapStatistics->set_total_heap_size_executable(executable);
   aHeapStatistics->set_used_heap_size(used);
+  aHeapStatistics->set_number_of_weak_handles(GetWeakHandleCount());
+  aHeapStatistics->set_weak_callbacks_last_gc(GetWeakCallbacksLastGC());
+}
+
+CompartmentHeapStatistics::CompartmentHeapStatistics() :
+  objects_size_(0),
+  strings_size_(0),
+  shapes_size_(0),
+  scripts_size_(0),
+  type_inference_size_(0),
+  mjit_code_size_(0),
+  unused_size_(0)
+{
+  name_[0] = '\0';
+}
 
-  // TODO: fill in the remaining stats
+size_t V8::GetCompartmentHeapStatistics(CompartmentHeapStatistics** aStats) {
+  *aStats = NULL;
+  JS::RuntimeStats rtStats(MallocSizeOf, CompartmentName,
+                           DestroyCompartmentName);
+  if (!JS::CollectRuntimeStats(rt(), &rtStats))
+    return 0;
+
+  size_t length = rtStats.compartmentStatsVector.length();
+  CompartmentHeapStatistics* stats =
+    new (std::nothrow) CompartmentHeapStatistics[length];
+  if (!stats)
+    return 0;
+  for (size_t i = 0; i < length; i++) {
+    JS::CompartmentStats& c = rtStats.compartmentStatsVector[i];
+    CompartmentHeapStatistics& out = stats[i];
+
+    const char* name = c.name ? static_cast<const char*>(c.name) : "";
+    strncpy(out.name_, name, sizeof(out.name_) - 1);
+    out.name_[sizeof(out.name_) - 1] = '\0';
+    out.objects_size_ = c.gcHeapObjectsNonFunction + c.gcHeapObjectsFunction +
+                        c.objectSlots + c.objectElements + c.objectMisc;
+    out.strings_size_ = c.gcHeapStrings + c.stringChars;
+    out.shapes_size_ = c.gcHeapShapesTree + c.gcHeapShapesDict +
+                       c.gcHeapShapesBase + c.shapesExtraTreeTables +
+                       c.shapesExtraDictTables + c.shapesExtraTreeShapeKids +
+                       c.shapesCompartmentTables;
+    out.scripts_size_ = c.gcHeapScripts + c.scriptData;
+    out.type_inference_size_ = c.gcHeapTypeObjects +
+                               c.typeInferenceSizes.objects +
+                               c.typeInferenceSizes.scripts +
+                               c.typeInferenceSizes.tables;
+#ifdef JS_METHODJIT
+    out.mjit_code_size_ = c.mjitCode + c.mjitData;
+#endif
+    out.unused_size_ = c.gcHeapArenaHeaders + c.gcHeapArenaPadding +
+                       c.gcHeapArenaUnused;
+  }
+  *aStats = stats;
+  return length;
 }
 
 const char* V8::GetVersion() {
@@ -145,40 +510,157 @@ const char* V8::GetVersion() {
 }
 
 void V8::SetFlagsFromCommandLine(int* argc, char** argv, bool aRemoveFlags) {
+  static const char kGCModeFlag[] = "--gc-mode=";
+  int kept = 0;
+  for (int i = 0; i < *argc; i++) {
+    const char* arg = argv[i];
+    bool recognized = true;
+    if (!arg) {
+      recognized = false;
+    } else if (!strcmp(arg, "--gc-mode=global")) {
+      isolate()->gcMode = JSGC_MODE_GLOBAL;
+    } else if (!strcmp(arg, "--gc-mode=compartment")) {
+      isolate()->gcMode = JSGC_MODE_COMPARTMENT;
+    } else if (!strncmp(arg, kGCModeFlag, sizeof(kGCModeFlag) - 1)) {
+      fprintf(stderr, "Unknown gc mode: %s\n", arg + sizeof(kGCModeFlag) - 1);
+    } else if (!strcmp(arg, "--expose_gc") || !strcmp(arg, "--expose-gc")) {
+      isolate()->exposeGC = true;
+    } else if (!strcmp(arg, "--help")) {
+      printf("Options:\n"
+             "  --gc-mode=global|compartment\n"
+             "        collect the whole heap at once, or one compartment at a time\n"
+             "  --expose_gc\n"
+             "        expose gc extension\n");
+      // As V8 does.
+      exit(0);
+    } else {
+      recognized = false;
+    }
+    if (!recognized || !aRemoveFlags) {
+      argv[kept++] = argv[i];
+    }
+  }
+  *argc = kept;
+
+  if (isolate()->runtime) {
+    ApplyResourceLimits();
+  }
 }
 
 void V8::SetFatalErrorHandler(FatalErrorCallback aCallback) {
-  gFatalCallback = aCallback;
+  isolate()->fatalCallback = aCallback;
 }
 
 int V8::AdjustAmountOfExternalAllocatedMemory(int aChangeInBytes) {
-  static int externalMemory = 0;
-  return externalMemory += aChangeInBytes;
+  // Growth counts against the engine's malloc limit just like its own
+  // allocations do, so churning through large external buffers triggers
+  // a collection, which in turn frees them.
+  if (aChangeInBytes > 0) {
+    JS_updateMallocCounter(cx(), size_t(aChangeInBytes));
+  }
+  int64_t total = isolate()->externalMemory += aChangeInBytes;
+  // The running total is 64 bits wide; like V8, report it saturated rather
+  // than wrapped once it no longer fits.
+  if (total > INT_MAX)
+    return INT_MAX;
+  if (total < INT_MIN)
+    return INT_MIN;
+  return int(total);
 }
 
 void V8::AddGCPrologueCallback(GCPrologueCallback aCallback, GCType aGCTypeFilter) {
-  UNIMPLEMENTEDAPI();
+  AddGCCallback(isolate()->gcPrologueCallbacks, aCallback, aGCTypeFilter);
+}
+
+void V8::RemoveGCPrologueCallback(GCPrologueCallback aCallback) {
+  RemoveGCCallback(isolate()->gcPrologueCallbacks, aCallback);
+}
+
+void V8::AddGCEpilogueCallback(GCEpilogueCallback aCallback, GCType aGCTypeFilter) {
+  AddGCCallback(isolate()->gcEpilogueCallbacks, aCallback, aGCTypeFilter);
+}
+
+void V8::RemoveGCEpilogueCallback(GCEpilogueCallback aCallback) {
+  RemoveGCCallback(isolate()->gcEpilogueCallbacks, aCallback);
+}
+
+void V8::GetGCStatistics(GCStatistics* aStats) {
+  *aStats = isolate()->gcStats;
 }
 
 void V8::LowMemoryNotification() {
-  UNIMPLEMENTEDAPI();
+  // The nearest thing SpiderMonkey has to a compacting collection.
+  isolate()->gcFlags = kGCCallbackFlagCompacted;
+  js::ShrinkingGC(cx(), js::gcreason::MEM_PRESSURE);
+  isolate()->gcFlags = kNoGCCallbackFlags;
 }
 
 JSBool V8::GCCallback(JSContext *cx, JSGCStatus status) {
-  if (status == JSGC_MARK_END) {
+  if (status == JSGC_BEGIN) {
+    CallGCCallbacks(isolate()->gcPrologueCallbacks, kGCTypeMarkSweepCompact);
+    isolate()->gcStart = PRMJ_Now();
+  } else if (status == JSGC_MARK_END) {
     PersistentGCReference::CheckForWeakHandles();
+  } else if (status == JSGC_END) {
+    isolate()->lastGCDuration = PRMJ_Now() - isolate()->gcStart;
+    isolate()->bytesAfterGC = JS_GetGCParameter(rt(), JSGC_BYTES);
+    isolate()->externalAfterGC = isolate()->externalMemory;
+
+    uint64_t pause = uint64_t(isolate()->lastGCDuration);
+    isolate()->gcStats.count_++;
+    isolate()->gcStats.total_pause_ += pause;
+    isolate()->gcStats.max_pause_ = js::Max(isolate()->gcStats.max_pause_, pause);
+    isolate()->gcStats.last_pause_ = pause;
+    for (int i = 0; i < kGCPhaseCount; i++) {
+      uint64_t time = cx->runtime->gcStats.phaseTime(kGCPhases[i]);
+      isolate()->gcStats.last_phase_times_[i] = time;
+      isolate()->gcStats.phase_times_[i] += time;
+    }
+    int bucket = 0;
+    for (uint64_t limit = PRMJ_USEC_PER_MSEC;
+         bucket < GCStatistics::kHistogramBuckets - 1 && pause >= limit;
+         limit *= 2) {
+      bucket++;
+    }
+    isolate()->gcStats.histogram_[bucket]++;
+
+    CallGCCallbacks(isolate()->gcEpilogueCallbacks, kGCTypeMarkSweepCompact);
   }
-  // TODO: what do I do here?
-  return JS_FALSE;
+  // Returning false at JSGC_BEGIN would veto the collection entirely.
+  return JS_TRUE;
+}
+
+bool SetResourceConstraints(ResourceConstraints *constraints) {
+  // Both spaces share the one GC heap.  The young space size is the closest
+  // thing to V8's scavenge interval, so it becomes the malloc trigger too.
+  // Executable memory is allocated by the method JIT outside the GC heap and
+  // has no limit to map to.
+  size_t young = js::Max(constraints->max_young_space_size(), 0);
+  size_t old = js::Max(constraints->max_old_space_size(), 0);
+  if (young || old) {
+    isolate()->maxBytes = uint32_t(js::Min(young + old, size_t(UINT32_MAX)));
+  }
+  if (young) {
+    isolate()->maxMallocBytes = uint32_t(young);
+  }
+  if (constraints->stack_limit()) {
+    isolate()->stackLimit = reinterpret_cast<uintptr_t>(constraints->stack_limit());
+  }
+
+  if (isolate()->runtime) {
+    ApplyResourceLimits();
+  }
+  return true;
 }
 
 void V8::ReportError(JSContext *ctx, const char *message, JSErrorReport *report) {
-  if (gFatalCallback) {
-    // TODO: figure this out
-    bool isFatal = false;
+  if (isolate()->fatalCallback) {
+    // Running out of heap is not something script can recover from, and the
+    // engine does not leave an exception for it to catch anyway.
+    bool isFatal = report->errorNumber == JSMSG_OUT_OF_MEMORY;
     if (isFatal) {
       // TODO: better location reporting?
-      gFatalCallback(report->filename, message);
+      isolate()->fatalCallback(report->filename, message);
     }
   }
   TryCatch::ReportError(ctx, message, report);
@@ -5,6 +5,53 @@ using namespace internal;
 
 JS_STATIC_ASSERT(sizeof(Function) == sizeof(GCReference));
 
+namespace {
+
+// Copies call arguments into a rooted jsval array.  Nearly every callback
+// node makes passes a handful of arguments, so those live on the stack and a
+// call into JS does no heap allocation.
+class CallArguments {
+  static const int kInlineCount = 8;
+
+public:
+  CallArguments(int argc, Handle<Value> argv[]) :
+    mValues(argc <= kInlineCount ? mInline : array_new<jsval>(argc)),
+    mRooter(cx(), 0, mValues)
+  {
+    if (!mValues) {
+      JS_ReportOutOfMemory(cx());
+      return;
+    }
+    for (int i = 0; i < argc; i++) {
+      mValues[i] = argv[i]->native();
+    }
+    mRooter.changeLength(argc);
+  }
+
+  ~CallArguments() {
+    if (mValues != mInline) {
+      array_delete(mValues);
+    }
+  }
+
+  // False when the arguments didn't fit on the stack and copying them out
+  // ran out of memory.  The error has already been reported.
+  bool ok() const {
+    return mValues != NULL;
+  }
+
+  jsval* values() {
+    return mValues;
+  }
+
+private:
+  jsval mInline[kInlineCount];
+  jsval* mValues;
+  JS::AutoArrayRooter mRooter;
+};
+
+} // anonymous namespace
+
 Function::operator JSFunction*() const {
   return JS_ValueToFunction(cx(), mVal);
 }
@@ -20,11 +67,10 @@ Local<Object> Function::NewInstance() const {
 }
 
 Local<Object> Function::NewInstance(int argc, Handle<Value> argv[]) const {
-  jsval *values = array_new<jsval>(argc);
-  for (int i = 0; i < argc; i++)
-    values[i] = argv[i]->native();
-  Object o(JS_New(cx(), JSVAL_TO_OBJECT(mVal), argc, values));
-  array_delete(values);
+  CallArguments args(argc, argv);
+  if (!args.ok())
+    return Local<Object>();
+  Object o(JS_New(cx(), JSVAL_TO_OBJECT(mVal), argc, args.values()));
   if (!o) {
     TryCatch::CheckForException();
     return Local<Object>();
@@ -34,17 +80,14 @@ Local<Object> Function::NewInstance(int argc, Handle<Value> argv[]) const {
 }
 
 Local<Value> Function::Call(Handle<Object> recv, int argc, Handle<Value> argv[]) const {
-  jsval *values = array_new<jsval>(argc);
-  for (int i = 0; i < argc; i++)
-    values[i] = argv[i]->native();
-  jsval rval;
-  if (!JS_CallFunctionValue(cx(), **recv, mVal, argc, values, &rval)) {
+  CallArguments args(argc, argv);
+  if (!args.ok())
+    return Local<Value>();
+  Value v(JSVAL_VOID);
+  if (!JS_CallFunctionValue(cx(), **recv, mVal, argc, args.values(), &v.native())) {
     TryCatch::CheckForException();
-    array_delete(values);
     return Local<Value>();
   }
-  Value v(rval);
-  array_delete(values);
   return Local<Value>::New(&v);
 }
 void Function::SetName(Handle<String> name) {
@@ -91,6 +91,20 @@ JSClass gFunctionTemplateClass = {
 };
 
 
+// The id of "prototype".  Interned strings live as long as the runtime, so it
+// only has to be looked up once per isolate.
+jsid
+PrototypeId()
+{
+  jsid &id = isolate()->prototypeId;
+  if (JSID_IS_VOID(id)) {
+    JSString* str = JS_InternString(cx(), "prototype");
+    JS_ASSERT(str);
+    id = INTERNED_STRING_TO_JSID(cx(), str);
+  }
+  return id;
+}
+
 } // anonymous namespace
 
 namespace internal {
@@ -137,12 +151,18 @@ FunctionTemplate::CallCallback(JSContext* cx,
   JSObject* thiz = NULL;
   bool isConstructing = JS_IsConstructing(cx, vp);
   if (isConstructing) {
-    thiz = **instanceTemplate->NewInstance();
-    Handle<Value> proto = fn.Get(String::NewSymbol("prototype"));
-    if (!proto.IsEmpty() && proto->IsObject()) {
-      Handle<Object> o = proto->ToObject();
-      (void) JS_SetPrototype(cx, thiz, **o);
+    // Create the instance directly against the function's current prototype
+    // rather than building one from the template and then replacing it.
+    jsval proto;
+    if (!JS_GetPropertyById(cx, fn, PrototypeId(), &proto)) {
+      return JS_FALSE;
     }
+    Local<Object> instance = instanceTemplate->NewInstance(
+      NULL, JSVAL_IS_OBJECT(proto) ? JSVAL_TO_OBJECT(proto) : NULL);
+    if (instance.IsEmpty()) {
+      return JS_FALSE;
+    }
+    thiz = **instance;
   } else {
     thiz = JS_THIS_OBJECT(cx, vp);
   }
@@ -269,14 +289,24 @@ FunctionTemplate::SetHiddenPrototype(bool value)
 bool
 FunctionTemplate::HasInstance(Handle<Value> v)
 {
-  Handle<Object> object = v->ToObject();
-  if (object.IsEmpty())
+  if (v.IsEmpty() || !v->IsObject())
+    return false;
+  // Instances are created against the function's prototype, so this is the
+  // same check instanceof makes.
+  PrivateData* pd = PrivateData::Get(InternalObject());
+  Local<Function> fn = pd->cachedFunction.get();
+  if (fn.IsEmpty())
     return false;
-  Handle<Object> proto = object->GetPrototype().As<Object>();
-  if (proto.IsEmpty()) {
+  jsval proto;
+  if (!JS_GetPropertyById(cx(), **fn, PrototypeId(), &proto) ||
+      !JSVAL_IS_OBJECT(proto) || JSVAL_IS_NULL(proto))
     return false;
+  JSObject* obj = JSVAL_TO_OBJECT(v->native());
+  while ((obj = JS_GetPrototype(obj))) {
+    if (obj == JSVAL_TO_OBJECT(proto))
+      return true;
   }
-  return InternalObject().Equals(proto);
+  return false;
 }
 
 } // namespace v8
@@ -1,82 +1,349 @@
 #include "v8-internal.h"
+#include "jscntxt.h"
+#include "jsgc.h"
+#include "gc/Memory.h"
 
 namespace v8 {
 using namespace internal;
 
 namespace internal {
-  template <typename SlotOps>
-  class ReferenceContainer {
-    static const size_t kBlockSize = 16;
-    struct SlotBlock {
-      typename SlotOps::Slot elements[kBlockSize];
-      SlotBlock *next;
+  // Local and persistent references are carved out of aligned chunks whose
+  // header records which kind of reference they hold.  Not every reference
+  // lives in one, though (the static booleans, accessor data slots), so a
+  // masked pointer is only trusted once the isolate's chunk registry has
+  // vouched for it.
+  struct Chunk {
+    static const size_t kSize = 16 * 1024;
+
+    enum Kind {
+      LOCAL,
+      PERSISTENT
     };
-    SlotBlock *mBlock;
-    size_t mUsedThisBlock;
-    void deallocateBlock() {
-      if (!mBlock)
-        return;
+    Kind kind;
 
-      SlotBlock *next = mBlock->next;
+    // Returns NULL if the reference doesn't live in one of our chunks.
+    static Chunk *FromReference(GCReference *ref) {
+      HandleChunkSet &chunks = isolate()->handleChunks;
+      if (!chunks.initialized())
+        return NULL;
+      void *chunk = reinterpret_cast<void*>(uintptr_t(ref) & ~(kSize - 1));
+      return chunks.has(chunk) ? static_cast<Chunk*>(chunk) : NULL;
+    }
+  };
 
-      while (mUsedThisBlock--)
-        SlotOps::onRemoveSlot(&mBlock->elements[mUsedThisBlock]);
+  static void *AllocateChunk(Chunk::Kind kind) {
+    HandleChunkSet &chunks = isolate()->handleChunks;
+    if (!chunks.initialized() && !chunks.init())
+      return NULL;
+    void *mem = js::gc::MapAlignedPages(Chunk::kSize, Chunk::kSize);
+    if (!mem)
+      return NULL;
+    if (!chunks.put(mem)) {
+      js::gc::UnmapPages(mem, Chunk::kSize);
+      return NULL;
+    }
+    static_cast<Chunk*>(mem)->kind = kind;
+    return mem;
+  }
+
+  static void ReleaseChunk(void *mem) {
+    isolate()->handleChunks.remove(mem);
+    js::gc::UnmapPages(mem, Chunk::kSize);
+  }
+
+  // Local handles are bump-allocated out of a chain of fixed-size slabs that
+  // is shared by every HandleScope.  A scope only remembers the slab and top
+  // pointer that were current when it was opened, so opening and closing a
+  // scope never allocates or touches the root table.  Instead, the used part
+  // of the arena is traced as one range from the extra roots tracer.
+  struct HandleSlab : public Chunk {
+    HandleSlab *next;
+    static const size_t kCount =
+      (Chunk::kSize - sizeof(Chunk) - sizeof(HandleSlab*)) / sizeof(GCReference);
+    GCReference elements[kCount];
+
+    GCReference *begin() {
+      return elements;
+    }
+    GCReference *end() {
+      return &elements[kCount];
+    }
+  };
+
+  // Persistent references are handed out from their own slabs and recycled
+  // through a free list.  Slabs are only returned to the system when the
+  // isolate is torn down.
+  union PersistentSlot {
+    PersistentSlot *nextFree;
+    char storage[sizeof(PersistentGCReference)];
+    jsval align;
+  };
+
+  struct PersistentSlab : public Chunk {
+    PersistentSlab *next;
+    static const size_t kCount =
+      (Chunk::kSize - sizeof(Chunk) - sizeof(PersistentSlab*)) / sizeof(PersistentSlot);
+    PersistentSlot slots[kCount];
+  };
+
+  static void *AllocatePersistent() {
+    IsolateState *state = isolate();
+    if (!state->freePersistents) {
+      PersistentSlab *slab =
+        static_cast<PersistentSlab*>(AllocateChunk(Chunk::PERSISTENT));
+      if (!slab)
+        return NULL;
+      slab->next = state->persistentSlabs;
+      state->persistentSlabs = slab;
+      for (size_t i = PersistentSlab::kCount; i > 0; i--) {
+        slab->slots[i - 1].nextFree = state->freePersistents;
+        state->freePersistents = &slab->slots[i - 1];
+      }
+    }
+    PersistentSlot *slot = state->freePersistents;
+    state->freePersistents = slot->nextFree;
+    return slot;
+  }
+
+  static void DestroyPersistent(PersistentGCReference *ref) {
+    IsolateState *state = isolate();
+    ref->~PersistentGCReference();
+    PersistentSlot *slot = reinterpret_cast<PersistentSlot*>(ref);
+    slot->nextFree = state->freePersistents;
+    state->freePersistents = slot;
+  }
+
+  // Slabs past the current one are kept around for reuse, so a deep scope
+  // nesting only pays for the allocation once.
+  static GCReference *AllocateHandle() {
+    IsolateState *state = isolate();
+    HandleSlab *current = state->currentSlab;
+    if (!current || state->top == current->end()) {
+      HandleSlab *slab = current ? current->next : state->firstSlab;
+      if (!slab) {
+        slab = static_cast<HandleSlab*>(AllocateChunk(Chunk::LOCAL));
+        JS_ASSERT(slab);
+        slab->next = NULL;
+        if (current)
+          current->next = slab;
+        else
+          state->firstSlab = slab;
+      }
+      state->currentSlab = slab;
+      state->top = slab->begin();
+    }
+    return state->top++;
+  }
+
+  void TraceHandles(JSTracer *tracer) {
+    IsolateState *state = isolate();
+    if (!state->currentSlab)
+      return;
+    for (HandleSlab *slab = state->firstSlab; slab; slab = slab->next) {
+      GCReference *end = slab == state->currentSlab ? state->top : slab->end();
+      for (GCReference *ref = slab->begin(); ref != end; ref++)
+        traceValue(tracer, ref->native());
+      if (slab == state->currentSlab)
+        break;
+    }
+  }
+
+  void DestroyHandles() {
+    IsolateState *state = isolate();
+    while (state->firstSlab) {
+      HandleSlab *next = state->firstSlab->next;
+      ReleaseChunk(state->firstSlab);
+      state->firstSlab = next;
+    }
+    state->currentSlab = NULL;
+    state->top = NULL;
+
+    // Leaked persistents are still registered as roots, and the runtime must
+    // not see them once their slab is gone.  Removing a root that was never
+    // added is harmless, so every slot can be unrooted blindly.
+    JSContext *ctx = cx();
+    while (state->persistentSlabs) {
+      PersistentSlab *slab = state->persistentSlabs;
+      for (size_t i = 0; i < PersistentSlab::kCount; i++)
+        JS_RemoveValueRoot(ctx, &reinterpret_cast<GCReference*>(&slab->slots[i])->native());
+      state->persistentSlabs = slab->next;
+      ReleaseChunk(slab);
+    }
+    state->freePersistents = NULL;
+  }
+
+  // Weak persistent handles are kept in dense, segmented tables, one per
+  // compartment, so that a compartment GC only looks at the handles whose
+  // referents it may collect.  Removed entries are threaded onto a free list
+  // (tagged with the low bit) and reused by the next MakeWeak.  Handles to
+  // primitives can never die and live in the table for the NULL compartment,
+  // which is never swept.  Weak callbacks may call MakeWeak while the GC is
+  // running, when the context can't allocate, so tables and their segments
+  // come from the system allocator.
+  class WeakHandleTable {
+    static const size_t kSegmentSize = 1024;
+    // Free entries hold the next index shifted left by one, so the end of the
+    // list has to survive that shift.
+    static const size_t kEndOfFreeList = size_t(-1) >> 1;
+
+    struct Segment {
+      uintptr_t entries[kSegmentSize];
+    };
+
+    js::Vector<Segment*, 0, js::SystemAllocPolicy> mSegments;
+    size_t mLength;
+    size_t mCount;
+    size_t mFreeList;
+
+    uintptr_t &entry(size_t index) {
+      return mSegments[index / kSegmentSize]->entries[index % kSegmentSize];
+    }
 
-      delete_(mBlock);
-      mUsedThisBlock = kBlockSize;
-      mBlock = next;
+    static bool isFree(uintptr_t e) {
+      return e & 1;
     }
+
   public:
-    ReferenceContainer() :
-      mBlock(NULL),
-      mUsedThisBlock(0)
+    WeakHandleTable() :
+      mLength(0), mCount(0), mFreeList(kEndOfFreeList)
     {}
-    typename SlotOps::Slot *allocate() {
-      if (mUsedThisBlock == kBlockSize || !mBlock) {
-        SlotBlock *block = new_<SlotBlock>();
-        block->next = mBlock;
-        mBlock = block;
-        mUsedThisBlock = 0;
-      }
-      typename SlotOps::Slot *slot = &mBlock->elements[mUsedThisBlock];
-      mUsedThisBlock++;
-      SlotOps::onNewSlot(slot);
-      return slot;
-    }
-    bool containsSlot(typename SlotOps::Slot *slot) {
-      SlotBlock *current = mBlock;
-      while (current) {
-        // XXX: this may rely on undefined behavior in C's memory model
-        if (slot >= current->elements || slot <= &current->elements[kBlockSize-1]) {
-          return true;
+
+    ~WeakHandleTable() {
+      for (size_t i = 0; i < mSegments.length(); i++)
+        js::Foreground::delete_(mSegments[i]);
+    }
+
+    size_t count() const {
+      return mCount;
+    }
+
+    bool add(PersistentGCReference *ref) {
+      size_t index = mFreeList;
+      if (index != kEndOfFreeList) {
+        mFreeList = entry(index) >> 1;
+      } else {
+        if (mLength == mSegments.length() * kSegmentSize) {
+          Segment *segment = js::OffTheBooks::new_<Segment>();
+          if (!segment || !mSegments.append(segment)) {
+            js::Foreground::delete_(segment);
+            return false;
+          }
         }
-        current = current->next;
+        index = mLength++;
       }
-      return false;
+      entry(index) = uintptr_t(ref);
+      ref->weakIndex = index;
+      mCount++;
+      return true;
+    }
+
+    void remove(PersistentGCReference *ref) {
+      size_t index = ref->weakIndex;
+      JS_ASSERT(entry(index) == uintptr_t(ref));
+      entry(index) = (uintptr_t(mFreeList) << 1) | 1;
+      mFreeList = index;
+      ref->weakIndex = PersistentGCReference::kNotWeak;
+      mCount--;
     }
-    ~ReferenceContainer() {
-      while (mBlock) {
-        deallocateBlock();
+
+    // Callbacks may dispose, create or revive weak handles, so every pass
+    // re-reads the entry instead of holding on to a pointer across a call.
+    size_t sweep() {
+      for (size_t i = 0; i < mLength; i++) {
+        uintptr_t e = entry(i);
+        if (isFree(e))
+          continue;
+        PersistentGCReference *ref = reinterpret_cast<PersistentGCReference*>(e);
+        jsval v = ref->native();
+        ref->isNearDeath = JSVAL_IS_GCTHING(v) &&
+          JS_IsAboutToBeFinalized(JSVAL_TO_GCTHING(v));
+      }
+      size_t fired = 0;
+      for (size_t i = 0; i < mLength; i++) {
+        uintptr_t e = entry(i);
+        if (isFree(e))
+          continue;
+        PersistentGCReference *ref = reinterpret_cast<PersistentGCReference*>(e);
+        if (ref->isNearDeath && ref->callback) {
+          Persistent<Value> h(reinterpret_cast<Value*>(ref));
+          ref->callback(h, ref->context);
+          fired++;
+        }
       }
+      for (size_t i = 0; i < mLength; i++) {
+        uintptr_t e = entry(i);
+        if (isFree(e))
+          continue;
+        PersistentGCReference *ref = reinterpret_cast<PersistentGCReference*>(e);
+        if (ref->isNearDeath)
+          DestroyPersistent(ref);
+      }
+      return fired;
     }
   };
 
-  struct GCOps {
-    typedef internal::GCReference Slot;
-    static void onNewSlot(Slot *s) {
-      s->root(cx());
+  static JSCompartment *CompartmentOf(jsval v) {
+    if (!JSVAL_IS_GCTHING(v))
+      return NULL;
+    return static_cast<js::gc::Cell*>(JSVAL_TO_GCTHING(v))->compartment();
+  }
+
+  static WeakHandleTable *TableFor(JSCompartment *compartment) {
+    WeakHandleTableMap &tables = isolate()->weakHandleTables;
+    if (!tables.initialized() && !tables.init())
+      return NULL;
+    WeakHandleTableMap::AddPtr p = tables.lookupForAdd(compartment);
+    if (p)
+      return p->value;
+    WeakHandleTable *table = js::OffTheBooks::new_<WeakHandleTable>();
+    if (!table || !tables.add(p, compartment, table)) {
+      js::Foreground::delete_(table);
+      return NULL;
     }
-    static void onRemoveSlot(Slot *s) {
-      s->unroot(cx());
+    return table;
+  }
+
+  size_t GetWeakHandleCount() {
+    WeakHandleTableMap &tables = isolate()->weakHandleTables;
+    size_t count = 0;
+    if (tables.initialized()) {
+      for (WeakHandleTableMap::Range r = tables.all(); !r.empty(); r.popFront())
+        count += r.front().value->count();
     }
-  };
+    return count;
+  }
 
-  class GCReferenceContainer : public ReferenceContainer<GCOps> {};
+  size_t GetWeakCallbacksLastGC() {
+    return isolate()->weakCallbacksLastGC;
+  }
+
+  // A dead compartment's referents have all been swept by now, so its table
+  // is empty; drop it before the address can be reused by a new compartment.
+  void DestroyWeakHandleTable(JSCompartment *compartment) {
+    WeakHandleTableMap &tables = isolate()->weakHandleTables;
+    if (!tables.initialized())
+      return;
+    WeakHandleTableMap::Ptr p = tables.lookup(compartment);
+    if (!p)
+      return;
+    JS_ASSERT(p->value->count() == 0);
+    js::Foreground::delete_(p->value);
+    tables.remove(p);
+  }
+
+  void DestroyWeakHandleTables() {
+    WeakHandleTableMap &tables = isolate()->weakHandleTables;
+    if (!tables.initialized())
+      return;
+    for (WeakHandleTableMap::Range r = tables.all(); !r.empty(); r.popFront())
+      js::Foreground::delete_(r.front().value);
+    tables.clear();
+  }
 
   PersistentGCReference::PersistentGCReference(GCReference *ref) :
     GCReference(*ref),
-    callback(NULL), context(NULL),
-    prev(NULL), next(NULL)
+    callback(NULL), context(NULL), isNearDeath(false),
+    weakIndex(kNotWeak)
   {}
 
   PersistentGCReference::~PersistentGCReference() {
@@ -87,68 +354,76 @@ namespace internal {
   void PersistentGCReference::MakeWeak(WeakReferenceCallback callback, void *context) {
     this->callback = callback;
     this->context = context;
-    next = weakPtrs;
-    if (next)
-      next->prev = this;
-    prev = NULL;
-    weakPtrs = this;
+    if (!IsWeak()) {
+      WeakHandleTable *table = TableFor(CompartmentOf(native()));
+      if (!table || !table->add(this))
+        return;
+    }
     unroot(cx());
   }
 
   void PersistentGCReference::ClearWeak(bool reroot) {
-    if (next)
-      next->prev = prev;
-    if (prev)
-      prev->next = next;
-    if (weakPtrs == this) {
-      JS_ASSERT(prev == NULL);
-      weakPtrs = next;
-    }
-    prev = next = NULL;
-    if (reroot)
+    if (IsWeak())
+      TableFor(CompartmentOf(native()))->remove(this);
+    // Marking is over by the time weak callbacks run, so a dying handle can't
+    // be revived by rooting it, as ObjectWrap's destructor tries to.
+    if (reroot && !isNearDeath)
       root(cx());
   }
 
-  PersistentGCReference *PersistentGCReference::weakPtrs = NULL;
-
   void PersistentGCReference::CheckForWeakHandles() {
-    PersistentGCReference *ref = weakPtrs;
-    while (ref != NULL) {
-      jsval v = ref->native();
-      ref->isNearDeath = JSVAL_IS_GCTHING(v) == JS_TRUE &&
-          JS_IsAboutToBeFinalized(JSVAL_TO_GCTHING(v)) == JS_TRUE;
-      PersistentGCReference *next = ref->next;
-      if (ref->isNearDeath && ref->callback) {
-        Persistent<Value> h(reinterpret_cast<Value*>(ref));
-        ref->callback(h, ref->context);
+    WeakHandleTableMap &tables = isolate()->weakHandleTables;
+    if (!tables.initialized())
+      return;
+    // A compartment GC can only finalize things in that compartment.
+    JSCompartment *collecting = rt()->gcCurrentCompartment;
+    size_t fired = 0;
+    if (collecting) {
+      WeakHandleTableMap::Ptr p = tables.lookup(collecting);
+      if (p)
+        fired = p->value->sweep();
+    } else {
+      // Callbacks can make new weak handles, which may add tables and
+      // rehash the map, so sweep from a copy of it.  There are only ever a
+      // few compartments, so the copy fits inline.
+      js::Vector<WeakHandleTable*, 8, js::SystemAllocPolicy> sweeping;
+      bool copied = true;
+      for (WeakHandleTableMap::Range r = tables.all(); !r.empty(); r.popFront()) {
+        if (r.front().key && !sweeping.append(r.front().value)) {
+          copied = false;
+          break;
+        }
+      }
+      if (copied) {
+        for (size_t i = 0; i < sweeping.length(); i++)
+          fired += sweeping[i]->sweep();
+      } else {
+        // Leaving dying handles unswept is worse than the rehash hazard.
+        for (WeakHandleTableMap::Range r = tables.all(); !r.empty(); r.popFront()) {
+          if (r.front().key)
+            fired += r.front().value->sweep();
+        }
       }
-      ref = next;
-    }
-    ref = weakPtrs;
-    while (ref != NULL) {
-      PersistentGCReference *next = ref->next;
-      if (ref->isNearDeath)
-        delete_(ref);
-      ref = next;
     }
+    isolate()->weakCallbacksLastGC = fired;
   }
 
   GCReference* GCReference::Globalize() {
-    GCReference *r = new_<PersistentGCReference>(this);
+    void *mem = AllocatePersistent();
+    JS_ASSERT(mem);
+    GCReference *r = new(mem) PersistentGCReference(this);
     r->root(cx());
     return r;
   }
 
   void GCReference::Dispose() {
+      // Local handles belong to the arena and die with their scope, and
+      // references we didn't hand out aren't ours to free.
+      Chunk *chunk = Chunk::FromReference(this);
+      if (!chunk || chunk->kind != Chunk::PERSISTENT)
+        return;
       unroot(cx());
-      // Yay no RTTI
-      if (HandleScope::IsLocalReference(this)) {
-        delete_(this);
-      } else {
-        PersistentGCReference *ref =
-          reinterpret_cast<PersistentGCReference*>(this);
-        delete_(ref);
-      }
+      DestroyPersistent(reinterpret_cast<PersistentGCReference*>(this));
   }
 
   GCReference *GCReference::Localize() {
@@ -156,13 +431,12 @@ namespace internal {
   }
 }
 
-HandleScope *HandleScope::sCurrent = 0;
-
-HandleScope::HandleScope() :
-  mGCReferences(new_<internal::GCReferenceContainer>()),
-  mPrevious(sCurrent)
-{
-  sCurrent = this;
+HandleScope::HandleScope() {
+  IsolateState *state = isolate();
+  mSlab = state->currentSlab;
+  mTop = state->top;
+  mPrevious = state->handleScope;
+  state->handleScope = this;
 }
 
 HandleScope::~HandleScope() {
@@ -175,37 +449,31 @@ HandleScope::~HandleScope() {
 internal::GCReference* HandleScope::InternalClose(internal::GCReference* ref) {
   JS_ASSERT(ref);
   JS_ASSERT(mPrevious);
-  JS_ASSERT(mGCReferences);
-  JS_ASSERT(sCurrent == this);
+  JS_ASSERT(isolate()->handleScope == this);
   jsval v = ref->native();
   Destroy();
   return HandleScope::CreateHandle(v);
 }
 
 void HandleScope::Destroy() {
-  if (sCurrent == this) {
-    sCurrent = mPrevious;
-    delete_(mGCReferences);
-    mGCReferences = NULL;
+  IsolateState *state = isolate();
+  if (state->handleScope == this) {
+    state->handleScope = mPrevious;
+    state->currentSlab = mSlab;
+    state->top = mTop;
   }
 }
 
 internal::GCReference *HandleScope::CreateHandle(internal::GCReference r) {
-  internal::GCReference *ref = sCurrent->mGCReferences->allocate();
+  JS_ASSERT(isolate()->handleScope);
+  internal::GCReference *ref = AllocateHandle();
   *ref = r;
   return ref;
 }
 
 bool HandleScope::IsLocalReference(GCReference *ref) {
-  HandleScope *current = sCurrent;
-  while (current != NULL) {
-    GCReferenceContainer *container = current->mGCReferences;
-    if (container->containsSlot(ref)) {
-      return true;
-    }
-    current = current->mPrevious;
-  }
-  return false;
+  Chunk *chunk = Chunk::FromReference(ref);
+  return chunk && chunk->kind == Chunk::LOCAL;
 }
 
 }
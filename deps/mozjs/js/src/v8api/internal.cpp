@@ -49,6 +49,8 @@ AccessorStorage::addAccessor(jsid name,
     setter,
     data,
     attribute,
+    NULL,
+    NULL,
   };
   AccessorTable::AddPtr slot = mStore.lookupForAdd(name);
   if (slot.found()) {
@@ -82,7 +84,12 @@ AccessorStorage::trace(JSTracer* tracer)
 {
   Range r = mStore.all();
   while (!r.empty()) {
-    r.front().value.data.trace(tracer);
+    PropertyData& data = r.front().value;
+    data.data.trace(tracer);
+    if (data.sharedGetter) {
+      traceValue(tracer, OBJECT_TO_JSVAL(data.sharedGetter));
+      traceValue(tracer, OBJECT_TO_JSVAL(data.sharedSetter));
+    }
     r.popFront();
   }
 }
@@ -1,9 +1,12 @@
 #include "v8-internal.h"
 // #include "jstl.h"
 // #include "jshashtable.h"
+#include "jsatom.h"
 #include "jsobj.h"
 #include "jstypedarray.h"
 #include "jsproxy.h"
+#include "jsweakmap.h"
+#include "jsobjinlines.h"
 #include "mozilla/Util.h"
 #include <limits>
 using namespace mozilla;
@@ -14,77 +17,331 @@ using namespace internal;
 JS_STATIC_ASSERT(sizeof(Object) == sizeof(GCReference));
 
 struct Object::PrivateData {
-  PrivateData() :
-    hiddenValues(Persistent<Object>::New(Object::New()))
+  void trace(JSTracer* tracer) {
+    hiddenValues.trace(tracer);
+  }
+
+  // Created the first time a hidden value is set.
+  Traced<Object> hiddenValues;
+};
+
+namespace {
+
+void
+pd_Trace(JSTracer* tracer,
+         JSObject* obj)
+{
+  Object::PrivateData* data =
+    static_cast<Object::PrivateData*>(JS_GetPrivate(obj));
+  if (data) {
+    data->trace(tracer);
+  }
+}
+
+void
+pd_finalize(JSContext* cx,
+            JSObject* obj)
+{
+  Object::PrivateData* data =
+    static_cast<Object::PrivateData*>(JS_GetPrivate(obj));
+  delete_(data);
+}
+
+// Holds an object's PrivateData.  The holder is only reachable through the
+// weak map below, so it is finalized in the same GC as the object it belongs
+// to.
+JSClass gPrivateDataClass = {
+  "PrivateData", // name
+  JSCLASS_HAS_PRIVATE, // flags
+  JS_PropertyStub, // addProperty
+  JS_PropertyStub, // delProperty
+  JS_PropertyStub, // getProperty
+  JS_StrictPropertyStub, // setProperty
+  JS_EnumerateStub, // enumerate
+  JS_ResolveStub, // resolve
+  JS_ConvertStub, // convert
+  pd_finalize, // finalize
+  NULL, // unused
+  NULL, // checkAccess
+  NULL, // call
+  NULL, // construct
+  NULL, // xdrObject
+  NULL, // hasInstance
+  pd_Trace, // trace
+};
+
+// What SetAccessor bound a getter/setter pair to.  Both trampolines keep the
+// holder object in their second reserved slot, so a call needs no lookups.
+struct AccessorData {
+  AccessorData(Handle<String> name,
+               AccessorGetter getter,
+               AccessorSetter setter,
+               Handle<Value> data,
+               JSClass* holderClass) :
+    getter(getter),
+    setter(setter),
+    name(name->native()),
+    data(data.IsEmpty() ? JSVAL_VOID : data->native()),
+    holderClass(holderClass)
   {
   }
 
-  ~PrivateData()
+  AccessorGetter getter;
+  AccessorSetter setter;
+  GCReference name;
+  GCReference data;
+  // Only compared against, never dereferenced.
+  JSClass* holderClass;
+
+  static AccessorData* Get(JSObject* fnObj) {
+    jsval holder = js::GetFunctionNativeReserved(fnObj, 1);
+    JS_ASSERT(JSVAL_IS_OBJECT(holder));
+    return static_cast<AccessorData*>(JS_GetPrivate(JSVAL_TO_OBJECT(holder)));
+  }
+
+  // The object the accessor was defined on: the owner recorded in the first
+  // reserved slot, or for a shared pair the nearest object of holderClass on
+  // the receiver's prototype chain.
+  JSObject* getHolder(JSObject* fnObj,
+                      JSObject* receiver) const {
+    jsval owner = js::GetFunctionNativeReserved(fnObj, 0);
+    if (JSVAL_IS_OBJECT(owner)) {
+      return JSVAL_TO_OBJECT(owner);
+    }
+    for (JSObject* o = receiver; o; o = JS_GetPrototype(o)) {
+      if (JS_GetClass(o) == holderClass) {
+        return o;
+      }
+    }
+    return receiver;
+  }
+};
+
+void
+ad_Trace(JSTracer* tracer,
+         JSObject* obj)
+{
+  AccessorData* data = static_cast<AccessorData*>(JS_GetPrivate(obj));
+  if (data) {
+    traceValue(tracer, data->name.native());
+    traceValue(tracer, data->data.native());
+  }
+}
+
+void
+ad_finalize(JSContext* cx,
+            JSObject* obj)
+{
+  AccessorData* data = static_cast<AccessorData*>(JS_GetPrivate(obj));
+  delete_(data);
+}
+
+JSClass gAccessorDataClass = {
+  "AccessorData", // name
+  JSCLASS_HAS_PRIVATE, // flags
+  JS_PropertyStub, // addProperty
+  JS_PropertyStub, // delProperty
+  JS_PropertyStub, // getProperty
+  JS_StrictPropertyStub, // setProperty
+  JS_EnumerateStub, // enumerate
+  JS_ResolveStub, // resolve
+  JS_ConvertStub, // convert
+  ad_finalize, // finalize
+  NULL, // unused
+  NULL, // checkAccess
+  NULL, // call
+  NULL, // construct
+  NULL, // xdrObject
+  NULL, // hasInstance
+  ad_Trace, // trace
+};
+
+// A property name in whichever form is cheapest to hand to the JSAPI.  Atoms
+// (everything String::NewSymbol returns, and most names that came from
+// script) and small integers are used as jsids directly; any other string is
+// passed as UC chars so that it is neither copied nor atomized.
+class PropertyKey {
+public:
+  PropertyKey(Handle<Value> key) :
+    mString(NULL),
+    mIsId(false)
   {
-    JS_ASSERT(!hiddenValues.IsEmpty());
-    hiddenValues.Dispose();
+    jsval v = key->native();
+    if (JSVAL_IS_INT(v) && JSVAL_TO_INT(v) >= 0 &&
+        INT_FITS_IN_JSID(JSVAL_TO_INT(v))) {
+      mId = INT_TO_JSID(JSVAL_TO_INT(v));
+      mIsId = true;
+      return;
+    }
+    if (JSVAL_IS_STRING(v)) {
+      mString = JSVAL_TO_STRING(v);
+    }
+    else {
+      // Keep the converted string alive for as long as we use its chars.
+      mConverted = key->ToString();
+      if (mConverted.IsEmpty()) {
+        return;
+      }
+      mString = JSVAL_TO_STRING(mConverted->native());
+    }
+    if (mString->isAtom()) {
+      mId = js_CheckForStringIndex(ATOM_TO_JSID(&mString->asAtom()));
+      mIsId = true;
+    }
+  }
+
+  bool IsValid() const {
+    return mIsId || mString;
+  }
+
+  bool Get(JSObject* obj,
+           jsval* vp) {
+    if (mIsId) {
+      return JS_GetPropertyById(cx(), obj, mId, vp);
+    }
+    const jschar* chars;
+    size_t length;
+    return Chars(&chars, &length) &&
+           JS_GetUCProperty(cx(), obj, chars, length, vp);
+  }
+
+  bool Set(JSObject* obj,
+           jsval* vp) {
+    if (mIsId) {
+      return JS_SetPropertyById(cx(), obj, mId, vp);
+    }
+    const jschar* chars;
+    size_t length;
+    return Chars(&chars, &length) &&
+           JS_SetUCProperty(cx(), obj, chars, length, vp);
+  }
+
+  bool Has(JSObject* obj,
+           JSBool* found) {
+    if (mIsId) {
+      return JS_HasPropertyById(cx(), obj, mId, found);
+    }
+    const jschar* chars;
+    size_t length;
+    return Chars(&chars, &length) &&
+           JS_HasUCProperty(cx(), obj, chars, length, found);
   }
 
-  Persistent<Object> hiddenValues;
-  AccessorStorage properties;
+  bool HasOwn(JSObject* obj,
+              JSBool* found) {
+    if (mIsId) {
+      return JS_AlreadyHasOwnPropertyById(cx(), obj, mId, found);
+    }
+    const jschar* chars;
+    size_t length;
+    return Chars(&chars, &length) &&
+           JS_AlreadyHasOwnUCProperty(cx(), obj, chars, length, found);
+  }
+
+  bool Delete(JSObject* obj,
+              jsval* rval) {
+    if (mIsId) {
+      return JS_DeletePropertyById2(cx(), obj, mId, rval);
+    }
+    const jschar* chars;
+    size_t length;
+    return Chars(&chars, &length) &&
+           JS_DeleteUCProperty2(cx(), obj, chars, length, rval);
+  }
+
+  // There is no jsid flavor of JS_SetPropertyAttributes, so this always goes
+  // by name.
+  bool SetAttributes(JSObject* obj,
+                     uintN attrs,
+                     JSBool* found) {
+    const jschar* chars;
+    size_t length;
+    return Chars(&chars, &length) &&
+           JS_SetUCPropertyAttributes(cx(), obj, chars, length, attrs, found);
+  }
+
+private:
+  bool Chars(const jschar** chars,
+             size_t* length) {
+    if (!mString) {
+      return false;
+    }
+    *chars = JS_GetStringCharsAndLength(cx(), mString, length);
+    return !!*chars;
+  }
+
+  JSString* mString;
+  Local<String> mConverted;
+  jsid mId;
+  bool mIsId;
 };
 
-typedef js::HashMap<JSObject*,Object::PrivateData*, js::DefaultHasher<JSObject*>, js::SystemAllocPolicy> ObjectPrivateDataMap;
+} // anonymous namespace
 
-static ObjectPrivateDataMap *gPrivateDataMap = 0;
-static ObjectPrivateDataMap& privateDataMap() {
-  if (!gPrivateDataMap) {
-    gPrivateDataMap = new_<ObjectPrivateDataMap>();
-    gPrivateDataMap->init(11);
+// Maps an object to its PrivateData holder.  Entries are ephemerons: a holder
+// is kept alive by its object only, and the entry is swept when the object
+// dies, so tracing only ever visits the private data of live objects.
+class internal::ObjectPrivateDataMap :
+  public js::WeakMap<js::HeapPtrObject, js::HeapValue>
+{
+public:
+  ObjectPrivateDataMap(JSRuntime *rt) :
+    js::WeakMap<js::HeapPtrObject, js::HeapValue>(rt)
+  {}
+};
+
+// Creates the map on first use; returns NULL when out of memory.
+static ObjectPrivateDataMap* privateDataMap() {
+  IsolateState *state = isolate();
+  if (!state->privateDataMap) {
+    ObjectPrivateDataMap *map = new_<ObjectPrivateDataMap>(rt());
+    if (!map || !map->init(11)) {
+      delete_(map);
+      return NULL;
+    }
+    state->privateDataMap = map;
   }
-  return *gPrivateDataMap;
+  return state->privateDataMap;
 }
 
 void
 internal::TraceObjectInternals(JSTracer* tracer,
                                void*)
 {
-  if (!gPrivateDataMap) {
+  ObjectPrivateDataMap *map = isolate()->privateDataMap;
+  if (!map) {
     return;
   }
-  ObjectPrivateDataMap::Range r = gPrivateDataMap->all();
-  while (!r.empty()) {
-    r.front().value->properties.trace(tracer);
-    r.popFront();
-  }
+  map->trace(tracer);
+}
+
+size_t
+internal::GetPrivateDataCount()
+{
+  ObjectPrivateDataMap *map = isolate()->privateDataMap;
+  return map ? map->count() : 0;
 }
 
 void
 internal::DestroyObjectInternals()
 {
-  if (!gPrivateDataMap) {
-    return;
-  }
-  ObjectPrivateDataMap::Range r = gPrivateDataMap->all();
-  while (!r.empty()) {
-    JS_ASSERT(!r.front().value->hiddenValues.IsEmpty());
-    r.front().value->hiddenValues.Dispose();
-    r.popFront();
-  }
-
-  delete_(gPrivateDataMap);
+  // The holders are finalized along with the runtime.
+  IsolateState *state = isolate();
+  delete_(state->privateDataMap);
+  state->privateDataMap = 0;
 }
 
 JSBool Object::JSAPIPropertyGetter(JSContext* cx, uintN argc, jsval* vp) {
   ApiExceptionBoundary boundary;
   HandleScope scope;
   JSObject* fnObj = JSVAL_TO_OBJECT(JS_CALLEE(cx, vp));
-  jsval accessorOwner = js::GetFunctionNativeReserved(fnObj, 0);
-  JS_ASSERT(JSVAL_IS_OBJECT(accessorOwner));
-  Object o(JSVAL_TO_OBJECT(accessorOwner));
-
-  jsval name = js::GetFunctionNativeReserved(fnObj, 1);
-  jsid id;
-  (void) JS_ValueToId(cx, name, &id);
-
-  AccessorStorage::PropertyData data = o.GetHiddenStore().properties.get(id);
-  AccessorInfo info(data.data.get(), JS_THIS_OBJECT(cx, vp), o);
-  Handle<Value> result = data.getter(String::FromJSID(id), info);
+  JSObject* thiz = JS_THIS_OBJECT(cx, vp);
+  AccessorData* accessor = AccessorData::Get(fnObj);
+  AccessorInfo info(reinterpret_cast<Value*>(&accessor->data),
+                    thiz, accessor->getHolder(fnObj, thiz));
+  Local<String> name =
+    Local<String>::New(reinterpret_cast<String*>(&accessor->name));
+  Handle<Value> result = accessor->getter(name, info);
   JS_SET_RVAL(cx, vp, result->native());
   return boundary.noExceptionOccured();
 }
@@ -93,18 +350,18 @@ JSBool Object::JSAPIPropertySetter(JSContext* cx, uintN argc, jsval* vp) {
   ApiExceptionBoundary boundary;
   HandleScope scope;
   JSObject* fnObj = JSVAL_TO_OBJECT(JS_CALLEE(cx, vp));
-  jsval accessorOwner = js::GetFunctionNativeReserved(fnObj, 0);
-  JS_ASSERT(JSVAL_IS_OBJECT(accessorOwner));
-  Object o(JSVAL_TO_OBJECT(accessorOwner));
-
-  jsval name = js::GetFunctionNativeReserved(fnObj, 1);
-  jsid id;
-  (void) JS_ValueToId(cx, name, &id);
-
-  AccessorStorage::PropertyData data = o.GetHiddenStore().properties.get(id);
-  AccessorInfo info(data.data.get(), JS_THIS_OBJECT(cx, vp), o);
+  JSObject* thiz = JS_THIS_OBJECT(cx, vp);
+  AccessorData* accessor = AccessorData::Get(fnObj);
+  if (!accessor->setter) {
+    // Read-only accessor; assignments are silently ignored.
+    return JS_TRUE;
+  }
+  AccessorInfo info(reinterpret_cast<Value*>(&accessor->data),
+                    thiz, accessor->getHolder(fnObj, thiz));
+  Local<String> name =
+    Local<String>::New(reinterpret_cast<String*>(&accessor->name));
   Value value(*JS_ARGV(cx, vp));
-  data.setter(String::FromJSID(id), &value, info);
+  accessor->setter(name, &value, info);
   return boundary.noExceptionOccured();
 }
 
@@ -112,16 +369,17 @@ bool
 Object::Set(Handle<Value> key,
             Handle<Value> value,
             PropertyAttribute attribs) {
-  // TODO: use String::Value
-  String::AsciiValue k(key);
+  PropertyKey k(key);
   jsval v = value->native();
   
-  if (!JS_SetProperty(cx(), *this, *k, &v)) {
+  if (!k.Set(*this, &v)) {
     TryCatch::CheckForException();
     return false;
   }
 
-  if (key->IsUint32())
+  // Assignment already creates properties as plain enumerable ones, and like
+  // V8 we leave the attributes of existing properties alone.
+  if (attribs == None || key->IsUint32())
     return true;
 
   uintN js_attribs = 0;
@@ -136,7 +394,7 @@ Object::Set(Handle<Value> key,
   }
 
   JSBool wasFound;
-  return JS_SetPropertyAttributes(cx(), *this, *k, js_attribs, &wasFound);
+  return k.SetAttributes(*this, js_attribs, &wasFound);
 }
 
 bool
@@ -166,11 +424,10 @@ Object::ForceSet(Handle<Value> key,
 
 Local<Value>
 Object::Get(Handle<Value> key) {
-  // TODO: use String::Value
-  String::AsciiValue k(key);
+  PropertyKey k(key);
   Value v(JSVAL_VOID);
 
-  if (JS_GetProperty(cx(), *this, *k, &v.native())) {
+  if (k.Get(*this, &v.native())) {
     return Local<Value>::New(&v);
   }
   TryCatch::CheckForException();
@@ -195,11 +452,10 @@ Object::Get(uint32_t index)
 bool
 Object::Has(Handle<String> key)
 {
-  // TODO: use String::Value
-  String::AsciiValue k(key);
+  PropertyKey k(key);
 
   JSBool found;
-  if (JS_HasProperty(cx(), *this, *k, &found)) {
+  if (k.Has(*this, &found)) {
     return !!found;
   }
   TryCatch::CheckForException();
@@ -224,11 +480,10 @@ Object::Has(uint32_t index)
 bool
 Object::Delete(Handle<String> key)
 {
-  // TODO: use String::Value
-  String::AsciiValue k(key);
+  PropertyKey k(key);
 
   jsval val;
-  if (JS_DeleteProperty2(cx(), *this, *k, &val)) {
+  if (k.Delete(*this, &val)) {
     return val == JSVAL_TRUE;
   }
   TryCatch::CheckForException();
@@ -271,34 +526,63 @@ Object::SetAccessor(Handle<String> name,
 
   jsid propid;
   JS_ValueToId(cx(), name->native(), &propid);
+  JSObject* getterObj;
+  JSObject* setterObj;
+  if (!NewAccessorPair(name, getter, setter, data, *this, NULL,
+                       &getterObj, &setterObj))
+    return false;
+
+  uintN attributes = JSPROP_GETTER | JSPROP_SETTER | JSPROP_SHARED;
+  if (!JS_DefinePropertyById(cx(), *this, propid,
+        JSVAL_VOID,
+        (JSPropertyOp)getterObj,
+        (JSStrictPropertyOp)setterObj,
+        attributes)) {
+    TryCatch::CheckForException();
+    return false;
+  }
+  return true;
+}
+
+// static
+bool
+Object::NewAccessorPair(Handle<String> name,
+                        AccessorGetter getter,
+                        AccessorSetter setter,
+                        Handle<Value> data,
+                        JSObject* owner,
+                        JSClass* holderClass,
+                        JSObject** getterObj,
+                        JSObject** setterObj)
+{
   JSFunction* getterFn =
       js::NewFunctionWithReserved(cx(), JSAPIPropertyGetter, 0, 0, NULL, NULL);
   if (!getterFn)
     return false;
-  JSObject *getterObj = JS_GetFunctionObject(getterFn);
+  *getterObj = JS_GetFunctionObject(getterFn);
 
   JSFunction* setterFn =
       js::NewFunctionWithReserved(cx(), JSAPIPropertySetter, 1, 0, NULL, NULL);
   if (!setterFn)
     return false;
-  JSObject *setterObj = JS_GetFunctionObject(setterFn);
+  *setterObj = JS_GetFunctionObject(setterFn);
 
-  js::SetFunctionNativeReserved(getterObj, 0, native());
-  js::SetFunctionNativeReserved(getterObj, 1, name->native());
-  js::SetFunctionNativeReserved(setterObj, 0, native());
-  js::SetFunctionNativeReserved(setterObj, 1, name->native());
-
-  uintN attributes = JSPROP_GETTER | JSPROP_SETTER | JSPROP_SHARED;
-  if (!JS_DefinePropertyById(cx(), *this, propid,
-        JSVAL_VOID,
-        (JSPropertyOp)getterObj,
-        (JSStrictPropertyOp)setterObj,
-        attributes)) {
-    TryCatch::CheckForException();
+  JSObject* holder = JS_NewObject(cx(), &gAccessorDataClass, NULL, NULL);
+  if (!holder)
+    return false;
+  AccessorData* accessorData =
+      new_<AccessorData>(name, getter, setter, data, holderClass);
+  if (!accessorData) {
+    JS_ReportOutOfMemory(cx());
     return false;
   }
-  PrivateData &store = GetHiddenStore();
-  store.properties.addAccessor(propid, getter, setter, data, attribs);
+  JS_SetPrivate(holder, accessorData);
+
+  jsval ownerVal = owner ? OBJECT_TO_JSVAL(owner) : JSVAL_VOID;
+  js::SetFunctionNativeReserved(*getterObj, 0, ownerVal);
+  js::SetFunctionNativeReserved(*getterObj, 1, OBJECT_TO_JSVAL(holder));
+  js::SetFunctionNativeReserved(*setterObj, 0, ownerVal);
+  js::SetFunctionNativeReserved(*setterObj, 1, OBJECT_TO_JSVAL(holder));
   return true;
 }
 
@@ -427,11 +711,10 @@ Object::SetPointerInInternalField(int index,
 bool
 Object::HasRealNamedProperty(Handle<String> key)
 {
-  // TODO: use String::Value
-  String::AsciiValue k(key);
+  PropertyKey k(key);
 
   JSBool found;
-  if (JS_AlreadyHasOwnProperty(cx(), *this, *k, &found)) {
+  if (k.HasOwn(*this, &found)) {
     return !!found;
   }
   return false;
@@ -496,44 +779,86 @@ Object::GetIdentityHash()
   return reinterpret_cast<intptr_t>(obj);
 }
 
-Object::PrivateData&
+Object::PrivateData*
 Object::GetHiddenStore()
 {
-  ObjectPrivateDataMap::Ptr p = privateDataMap().lookup(*this);
-  PrivateData *pd;
-  if (p.found()) {
-    pd = p->value;
-  } else {
-    pd = new_<PrivateData>();
-    ObjectPrivateDataMap::AddPtr slot = privateDataMap().lookupForAdd(*this);
-    privateDataMap().add(slot, *this, pd);
+  ObjectPrivateDataMap *map = isolate()->privateDataMap;
+  if (!map) {
+    return NULL;
   }
-  return *pd;
+  ObjectPrivateDataMap::Ptr p = map->lookup(*this);
+  if (!p) {
+    return NULL;
+  }
+  JSObject* holder = &p->value.toObject();
+  return static_cast<PrivateData*>(JS_GetPrivate(holder));
+}
+
+Object::PrivateData*
+Object::CreateHiddenStore()
+{
+  PrivateData* pd = GetHiddenStore();
+  if (pd) {
+    return pd;
+  }
+
+  ObjectPrivateDataMap *map = privateDataMap();
+  if (!map) {
+    return NULL;
+  }
+  pd = new_<PrivateData>();
+  if (!pd) {
+    return NULL;
+  }
+  JSObject* holder = JS_NewObject(cx(), &gPrivateDataClass, NULL, NULL);
+  if (!holder) {
+    delete_(pd);
+    return NULL;
+  }
+  // From here on the holder's finalizer owns pd.
+  JS_SetPrivate(holder, pd);
+  // Creating the holder may have run a GC, so the map is probed again.
+  if (!map->put(*this, js::ObjectValue(*holder))) {
+    return NULL;
+  }
+  return pd;
 }
 
 bool
 Object::SetHiddenValue(Handle<String> key,
                        Handle<Value> value)
 {
-  PrivateData& pd = GetHiddenStore();
-  JS_ASSERT(!pd.hiddenValues.IsEmpty());
-  return pd.hiddenValues->Set(key, value);
+  PrivateData* pd = CreateHiddenStore();
+  if (!pd) {
+    return false;
+  }
+  if (!pd->hiddenValues) {
+    pd->hiddenValues = Object::New();
+    if (!pd->hiddenValues) {
+      return false;
+    }
+  }
+  return pd->hiddenValues->Set(key, value);
 }
 
 Local<Value>
 Object::GetHiddenValue(Handle<String> key)
 {
-  PrivateData& pd = GetHiddenStore();
-  JS_ASSERT(!pd.hiddenValues.IsEmpty());
-  return pd.hiddenValues->Get(key);
+  PrivateData* pd = GetHiddenStore();
+  if (!pd || !pd->hiddenValues) {
+    return Local<Value>();
+  }
+  return pd->hiddenValues->Get(key);
 }
 
 bool
 Object::DeleteHiddenValue(Handle<String> key)
 {
-  PrivateData& pd = GetHiddenStore();
-  JS_ASSERT(!pd.hiddenValues.IsEmpty());
-  return pd.hiddenValues->Delete(key);
+  PrivateData* pd = GetHiddenStore();
+  if (!pd || !pd->hiddenValues) {
+    return false;
+  }
+  return pd->hiddenValues->Delete(key);
 }
 
 bool
@@ -587,28 +912,56 @@ Object::GetIndexedPropertiesPixelDataLength()
   UNIMPLEMENTEDAPI(0);
 }
 
+// node's Buffers are proxies that keep their typed array in the first extra
+// slot (see SetRawArray in node_buffer.cc).
 static JSObject* grabTypedArray(JSObject* obj) {
   if (js_IsTypedArray(obj))
     return obj;
   if (!js::IsObjectProxy(obj))
     return NULL;
-  jsid name = INTERNED_STRING_TO_JSID(cx(), JS_InternString(cx(), "rawArray"));
-  js::Value v;
-  js::Proxy::get(cx(), obj, obj, name, &v);
-  if (v.isObjectOrNull())
-    return v.toObjectOrNull();
+  const js::Value &v = js::GetProxyExtra(obj, 0);
+  if (v.isObject() && js_IsTypedArray(&v.toObject()))
+    return &v.toObject();
   return NULL;
 }
 
+// ExternalArrayType starts at one and lists the element types in the same
+// order as js::TypedArray, apart from the clamped pixel arrays.
+static ExternalArrayType
+toExternalArrayType(uint32_t type)
+{
+  if (type == js::TypedArray::TYPE_UINT8_CLAMPED)
+    return kExternalPixelArray;
+  return static_cast<ExternalArrayType>(kExternalByteArray + type);
+}
+
+static uint32_t
+fromExternalArrayType(ExternalArrayType type)
+{
+  if (type == kExternalPixelArray)
+    return js::TypedArray::TYPE_UINT8_CLAMPED;
+  return type - kExternalByteArray;
+}
+
 void
 Object::SetIndexedPropertiesToExternalArrayData(void* data,
                                                 ExternalArrayType array_type,
                                                 int number_of_elements)
 {
-  JS_ASSERT(HasIndexedPropertiesInExternalArrayData());
-  JS_ASSERT (array_type == GetIndexedPropertiesExternalArrayDataType());
   if (number_of_elements < 0)
     return;
+  // Template instances, such as a native SlowBuffer, serve indexed access to
+  // the data from their class hooks.  Anything else that isn't a typed array
+  // has nowhere to keep it.
+  if (!grabTypedArray(*this)) {
+    if (!SetInstanceExternalArrayData(*this, data, array_type, number_of_elements)) {
+      ThrowException(Exception::TypeError(
+        String::New("Object can't hold external array data")));
+      TryCatch::CheckForException();
+    }
+    return;
+  }
+  JS_ASSERT (array_type == GetIndexedPropertiesExternalArrayDataType());
   // At this point I'm going to cheat. If it's a typed array already, then I'll create 
   // a new one from this one.
 
@@ -618,13 +971,14 @@ Object::SetIndexedPropertiesToExternalArrayData(void* data,
   // then we'll just create a new TypedArray and replace this*. If we're working
   // with a Proxy, then we need to re-set
 //  JSObject* arr = grabTypedArray(*this);
-  size_t elemSize = js::TypedArray::slotWidth(array_type);
+  uint32_t type = fromExternalArrayType(array_type);
+  size_t elemSize = js::TypedArray::slotWidth(type);
   size_t bufferSize = elemSize * number_of_elements;
   // create the typed array buffer
   JSObject* newBuf = js::ArrayBuffer::create(cx(), bufferSize, reinterpret_cast<uint8_t*>(data));
     
   // create the new typed array
-  JSObject* newArr = js_CreateTypedArrayWithBuffer(cx(), array_type, newBuf, 0, number_of_elements);
+  JSObject* newArr = js_CreateTypedArrayWithBuffer(cx(), type, newBuf, 0, number_of_elements);
 
   if (js_IsTypedArray(*this)) {
     *this = newArr;
@@ -640,28 +994,50 @@ Object::SetIndexedPropertiesToExternalArrayData(void* data,
 bool
 Object::HasIndexedPropertiesInExternalArrayData()
 {
-  return grabTypedArray(*this) != NULL;
+  void* data;
+  ExternalArrayType type;
+  int length;
+  return grabTypedArray(*this) != NULL ||
+         GetInstanceExternalArrayData(*this, &data, &type, &length);
 }
 
 void*
 Object::GetIndexedPropertiesExternalArrayData()
 {
   JS_ASSERT(HasIndexedPropertiesInExternalArrayData());
-  return JS_GetTypedArrayData(grabTypedArray(*this));
+  if (JSObject* arr = grabTypedArray(*this))
+    return JS_GetTypedArrayData(arr);
+  void* data;
+  ExternalArrayType type;
+  int length;
+  GetInstanceExternalArrayData(*this, &data, &type, &length);
+  return data;
 }
 
 ExternalArrayType
 Object::GetIndexedPropertiesExternalArrayDataType()
 {
   JS_ASSERT(HasIndexedPropertiesInExternalArrayData());
-  return kExternalUnsignedByteArray;
+  if (JSObject* arr = grabTypedArray(*this))
+    return toExternalArrayType(JS_GetTypedArrayType(arr));
+  void* data;
+  ExternalArrayType type;
+  int length;
+  GetInstanceExternalArrayData(*this, &data, &type, &length);
+  return type;
 }
 
 int
 Object::GetIndexedPropertiesExternalArrayDataLength()
 {
   JS_ASSERT(HasIndexedPropertiesInExternalArrayData());
-  return JS_GetTypedArrayByteLength(grabTypedArray(*this));
+  if (JSObject* arr = grabTypedArray(*this))
+    return JS_GetTypedArrayLength(arr);
+  void* data;
+  ExternalArrayType type;
+  int length;
+  GetInstanceExternalArrayData(*this, &data, &type, &length);
+  return length;
 }
 
 Object::Object(JSObject *obj) :
@@ -67,6 +67,8 @@ struct PrivateData
   Traced<Value> indexedData;
 
   Traced<ObjectTemplate> prototype;
+  // The instance of prototype that every standalone NewInstance shares.
+  Traced<Object> prototypeInstance;
 
   JSClass cls;
   char* name;
@@ -76,7 +78,10 @@ struct ObjectTemplateHandle
 {
   ObjectTemplateHandle(Handle<ObjectTemplate> ot, JSObject* holder) :
     objectTemplate(ot),
-    holder(holder)
+    holder(holder),
+    externalData(NULL),
+    externalType(ExternalArrayType(0)),
+    externalLength(0)
   {
     JS_ASSERT(!ot.IsEmpty());
     JS_ASSERT(holder != NULL);
@@ -118,8 +123,110 @@ struct ObjectTemplateHandle
   // It's ok not to trace this because holder is the only reference to this
   // structure.
   JSObject* holder;
+
+  // Set by Object::SetIndexedPropertiesToExternalArrayData.  A type of zero
+  // means the instance has no external array data.
+  void* externalData;
+  ExternalArrayType externalType;
+  uint32_t externalLength;
 };
 
+// Returns the handle of obj if it is a template instance whose external array
+// data covers id, or NULL.  The class hooks also run for objects that merely
+// inherit from an instance, and those have no handle of their own.
+ObjectTemplateHandle*
+ExternalArrayHandle(JSObject* obj,
+                    jsid id)
+{
+  if (!JSID_IS_INT(id) || JSID_TO_INT(id) < 0)
+    return NULL;
+  if (JS_GetClass(obj)->delProperty != o_DeleteProperty)
+    return NULL;
+  ObjectTemplateHandle* h = static_cast<ObjectTemplateHandle*>(JS_GetPrivate(obj));
+  if (!h || !h->externalType || uint32_t(JSID_TO_INT(id)) >= h->externalLength)
+    return NULL;
+  return h;
+}
+
+JSBool
+GetExternalElement(JSContext* cx,
+                   ObjectTemplateHandle* h,
+                   uint32_t index,
+                   jsval* vp)
+{
+  void* data = h->externalData;
+  switch (h->externalType) {
+    case kExternalByteArray:
+      *vp = INT_TO_JSVAL(static_cast<int8_t*>(data)[index]);
+      return JS_TRUE;
+    case kExternalUnsignedByteArray:
+    case kExternalPixelArray:
+      *vp = INT_TO_JSVAL(static_cast<uint8_t*>(data)[index]);
+      return JS_TRUE;
+    case kExternalShortArray:
+      *vp = INT_TO_JSVAL(static_cast<int16_t*>(data)[index]);
+      return JS_TRUE;
+    case kExternalUnsignedShortArray:
+      *vp = INT_TO_JSVAL(static_cast<uint16_t*>(data)[index]);
+      return JS_TRUE;
+    case kExternalIntArray:
+      *vp = INT_TO_JSVAL(static_cast<int32_t*>(data)[index]);
+      return JS_TRUE;
+    case kExternalUnsignedIntArray:
+      return JS_NewNumberValue(cx, static_cast<uint32_t*>(data)[index], vp);
+    case kExternalFloatArray:
+      return JS_NewNumberValue(cx, static_cast<float*>(data)[index], vp);
+    case kExternalDoubleArray:
+      return JS_NewNumberValue(cx, static_cast<double*>(data)[index], vp);
+  }
+  JS_NOT_REACHED("bad external array type");
+  return JS_FALSE;
+}
+
+JSBool
+SetExternalElement(JSContext* cx,
+                   ObjectTemplateHandle* h,
+                   uint32_t index,
+                   jsval v)
+{
+  jsdouble d;
+  if (!JS_ValueToNumber(cx, v, &d))
+    return JS_FALSE;
+  void* data = h->externalData;
+  switch (h->externalType) {
+    case kExternalByteArray:
+      static_cast<int8_t*>(data)[index] = int8_t(JS_DoubleToInt32(d));
+      return JS_TRUE;
+    case kExternalUnsignedByteArray:
+      static_cast<uint8_t*>(data)[index] = uint8_t(JS_DoubleToUint32(d));
+      return JS_TRUE;
+    case kExternalPixelArray:
+      static_cast<uint8_t*>(data)[index] =
+        !(d > 0) ? 0 : d > 255 ? 255 : uint8_t(d + 0.5);
+      return JS_TRUE;
+    case kExternalShortArray:
+      static_cast<int16_t*>(data)[index] = int16_t(JS_DoubleToInt32(d));
+      return JS_TRUE;
+    case kExternalUnsignedShortArray:
+      static_cast<uint16_t*>(data)[index] = uint16_t(JS_DoubleToUint32(d));
+      return JS_TRUE;
+    case kExternalIntArray:
+      static_cast<int32_t*>(data)[index] = JS_DoubleToInt32(d);
+      return JS_TRUE;
+    case kExternalUnsignedIntArray:
+      static_cast<uint32_t*>(data)[index] = JS_DoubleToUint32(d);
+      return JS_TRUE;
+    case kExternalFloatArray:
+      static_cast<float*>(data)[index] = float(d);
+      return JS_TRUE;
+    case kExternalDoubleArray:
+      static_cast<double*>(data)[index] = d;
+      return JS_TRUE;
+  }
+  JS_NOT_REACHED("bad external array type");
+  return JS_FALSE;
+}
+
 JSBool
 o_DeleteProperty(JSContext* cx,
                  JSObject* obj,
@@ -158,6 +265,9 @@ o_GetProperty(JSContext* cx,
               jsid id,
               jsval* vp)
 {
+  if (ObjectTemplateHandle* h = ExternalArrayHandle(obj, id))
+    return GetExternalElement(cx, h, JSID_TO_INT(id), vp);
+
   ApiExceptionBoundary boundary;
   Local<ObjectTemplate> ot = ObjectTemplateHandle::GetHandle(obj);
   PrivateData* pd = PrivateData::Get(ot);
@@ -193,6 +303,9 @@ o_SetProperty(JSContext* cx,
               JSBool strict,
               jsval* vp)
 {
+  if (ObjectTemplateHandle* h = ExternalArrayHandle(obj, id))
+    return SetExternalElement(cx, h, JSID_TO_INT(id), *vp);
+
   ApiExceptionBoundary boundary;
   Local<ObjectTemplate> ot = ObjectTemplateHandle::GetHandle(obj);
   PrivateData* pd = PrivateData::Get(ot);
@@ -289,6 +402,7 @@ ot_Trace(JSTracer* tracer,
   data->namedData.trace(tracer);
   data->indexedData.trace(tracer);
   data->prototype.trace(tracer);
+  data->prototypeInstance.trace(tracer);
 }
 
 void
@@ -322,6 +436,36 @@ JSClass gObjectTemplateClass = {
 } // anonymous namespace
 
 namespace internal {
+bool SetInstanceExternalArrayData(JSObject* obj,
+                                  void* data,
+                                  ExternalArrayType type,
+                                  int length) {
+  if (JS_GetClass(obj)->delProperty != o_DeleteProperty)
+    return false;
+  ObjectTemplateHandle* h = static_cast<ObjectTemplateHandle*>(JS_GetPrivate(obj));
+  if (!h)
+    return false;
+  h->externalData = data;
+  h->externalType = type;
+  h->externalLength = length;
+  return true;
+}
+
+bool GetInstanceExternalArrayData(JSObject* obj,
+                                  void** data,
+                                  ExternalArrayType* type,
+                                  int* length) {
+  if (JS_GetClass(obj)->delProperty != o_DeleteProperty)
+    return false;
+  ObjectTemplateHandle* h = static_cast<ObjectTemplateHandle*>(JS_GetPrivate(obj));
+  if (!h || !h->externalType)
+    return false;
+  *data = h->externalData;
+  *type = h->externalType;
+  *length = h->externalLength;
+  return true;
+}
+
 bool IsObjectTemplate(Handle<Value> v) {
   if (v.IsEmpty())
     return false;
@@ -344,6 +488,7 @@ void ObjectTemplate::SetPrototype(Handle<ObjectTemplate> o) {
   PrivateData* pd = PrivateData::Get(InternalObject());
   JS_ASSERT(pd);
   pd->prototype = o;
+  pd->prototypeInstance = Handle<Object>();
 }
 
 void ObjectTemplate::SetObjectName(Handle<String> s) {
@@ -371,12 +516,21 @@ ObjectTemplate::NewInstance(JSObject* parent)
   PrivateData* pd = PrivateData::Get(InternalObject());
   JS_ASSERT(pd);
 
-  // We've set everything we care about on our InternalObject, so we can assign
-  // that to the prototype of our new object.
+  if (pd->prototype && !pd->prototypeInstance) {
+    pd->prototypeInstance = pd->prototype->NewInstance();
+  }
+  Local<Object> proto = pd->prototypeInstance.get();
+  return NewInstance(parent, proto.IsEmpty() ? NULL : **proto);
+}
+
+Local<Object>
+ObjectTemplate::NewInstance(JSObject* parent,
+                            JSObject* proto)
+{
+  PrivateData* pd = PrivateData::Get(InternalObject());
+  JS_ASSERT(pd);
+
   JSClass* cls = &pd->cls;
-  JSObject* proto = pd->prototype
-                  ? **pd->prototype->NewInstance()
-                  : NULL;
   if (!parent)
     parent = **Context::GetCurrent()->Global();
 
@@ -407,13 +561,27 @@ ObjectTemplate::NewInstance(JSObject* parent)
     attributes.popFront();
   }
 
-  // Set all things that were added with SetAccessor on the object.
+  // Define everything that was added with SetAccessor.  The trampolines are
+  // built once per template and shared by all of its instances; they find
+  // the instance again through its class.
   AccessorStorage::Range accessors = pd->accessors.all();
   while (!accessors.empty()) {
     AccessorStorage::Entry& entry = accessors.front();
     AccessorStorage::PropertyData& data = entry.value;
-    (void)o.SetAccessor(String::FromJSID(entry.key), data.getter, data.setter,
-                        data.data.get(), DEFAULT, data.attribute);
+    if (!data.sharedGetter &&
+        !Object::NewAccessorPair(String::FromJSID(entry.key), data.getter,
+                                 data.setter, data.data.get(), NULL, cls,
+                                 &data.sharedGetter, &data.sharedSetter)) {
+      data.sharedGetter = data.sharedSetter = NULL;
+      return Local<Object>();
+    }
+    uintN attributes = JSPROP_GETTER | JSPROP_SETTER | JSPROP_SHARED;
+    if (!JS_DefinePropertyById(cx(), obj, entry.key, JSVAL_VOID,
+                               (JSPropertyOp)data.sharedGetter,
+                               (JSStrictPropertyOp)data.sharedSetter,
+                               attributes)) {
+      return Local<Object>();
+    }
     accessors.popFront();
   }
 
@@ -1,5 +1,8 @@
 #include "v8-internal.h"
 #include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 namespace v8 {
 using namespace internal;
@@ -87,17 +90,226 @@ String::FromJSID(jsid id)
   return Local<String>::New(&s);
 }
 
+namespace {
+
+// A JSStringFinalizer is only handed itself and the characters, so every
+// external string gets its own finalizer that knows which resource to
+// dispose.  It is freed without a context since strings can be finalized
+// while the runtime is being torn down.
+struct ExternalStringFinalizer : public JSStringFinalizer {
+  String::ExternalStringResourceBase* resource;
+};
+
+} // anonymous namespace
+
+// static
+void
+String::FinalizeExternal(const JSStringFinalizer* fin,
+                         jschar* chars)
+{
+  ExternalStringFinalizer* external = const_cast<ExternalStringFinalizer*>(
+    static_cast<const ExternalStringFinalizer*>(fin));
+  external->resource->Dispose();
+  js::Foreground::delete_(external);
+}
+
 // static
 Local<String>
-String::NewExternal(ExternalAsciiStringResource* external)
+String::NewExternal(ExternalStringResource* external)
 {
+  const jschar* chars = reinterpret_cast<const jschar*>(external->data());
+  size_t length = external->length();
+  if (!external->IsTerminated()) {
+    Local<String> str = String::New(external->data(), length);
+    external->Dispose();
+    return str;
+  }
+  JS_ASSERT(chars[length] == 0);
 
-  // TODO (Issue #58) Do not copy the string here!
+  ExternalStringFinalizer* fin =
+    js::OffTheBooks::new_<ExternalStringFinalizer>();
+  if (!fin) {
+    external->Dispose();
+    return Local<String>();
+  }
+  fin->finalize = FinalizeExternal;
+  fin->resource = external;
+  JSString* str = JS_NewExternalString(cx(), chars, length, fin);
+  if (!str) {
+    js::Foreground::delete_(fin);
+    external->Dispose();
+    return Local<String>();
+  }
+  String s(str);
+  return Local<String>::New(&s);
+}
+
+// static
+Local<String>
+String::NewExternal(ExternalAsciiStringResource* external)
+{
+  // SpiderMonkey strings are always two-byte, so ASCII data has to be
+  // inflated into a copy of its own.
   Local<String> str = String::New(external->data(), external->length());
   external->Dispose();
-  return Local<String>::New(str);
+  return str;
+}
+
+bool
+String::IsExternal() const
+{
+  return JS_IsExternalString(*this);
+}
+
+namespace {
+
+// A UTF-16 code unit never needs more than three bytes of UTF-8; surrogate
+// pairs take four bytes for two units.
+const int kMaxUtf8BytesPerUnit = 3;
+// Utf8Value skips measuring strings up to this many code units.
+const int kUtf8ValueSinglePassLength = 4096;
+
+#ifdef __SSE2__
+// Sixteen code units are handled per step: two loads narrowed by one pack.
+const size_t kBlockUnits = 16;
+
+inline __m128i
+LoadUnits(const jschar* chars)
+{
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(chars));
 }
 
+// True if every code unit in the block starting at chars is below 0x80.
+inline bool
+IsAsciiBlock(const jschar* chars)
+{
+  const __m128i highBits = _mm_set1_epi16(static_cast<short>(0xFF80));
+  __m128i bits = _mm_and_si128(_mm_or_si128(LoadUnits(chars),
+                                            LoadUnits(chars + 8)),
+                               highBits);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(bits, _mm_setzero_si128())) ==
+         0xFFFF;
+}
+#endif
+
+// Copies the leading run of ASCII characters, up to n of them, and returns
+// how many were copied.
+inline size_t
+CopyAsciiPrefix(const jschar* src,
+                char* dst,
+                size_t n)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + kBlockUnits <= n && IsAsciiBlock(&src[i]); i += kBlockUnits) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]),
+                     _mm_packus_epi16(LoadUnits(&src[i]),
+                                      LoadUnits(&src[i + 8])));
+  }
+#endif
+  for (; i < n && src[i] < 0x80; i++) {
+    dst[i] = static_cast<char>(src[i]);
+  }
+  return i;
+}
+
+// Keeps the low byte of each of the n code units, as V8 does, except that
+// embedded NULs become spaces so the result stays a usable C string.
+void
+NarrowToLatin1(const jschar* src,
+               char* dst,
+               size_t n)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i lowByte = _mm_set1_epi16(0x00FF);
+  const __m128i space = _mm_set1_epi16(' ');
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + kBlockUnits <= n; i += kBlockUnits) {
+    __m128i a = _mm_and_si128(LoadUnits(&src[i]), lowByte);
+    __m128i b = _mm_and_si128(LoadUnits(&src[i + 8]), lowByte);
+    a = _mm_or_si128(a, _mm_and_si128(_mm_cmpeq_epi16(a, zero), space));
+    b = _mm_or_si128(b, _mm_and_si128(_mm_cmpeq_epi16(b, zero), space));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dst[i]),
+                     _mm_packus_epi16(a, b));
+  }
+#endif
+  for (; i < n; i++) {
+    char c = static_cast<char>(src[i]);
+    dst[i] = c ? c : ' ';
+  }
+}
+
+// Returns the code point at chars[i] and how many units it spans.  Unpaired
+// surrogates decode as U+FFFD.
+inline uint32_t
+DecodeCodePoint(const jschar* chars,
+                size_t i,
+                size_t len,
+                size_t* units)
+{
+  uint32_t c = chars[i];
+  *units = 1;
+  if (c < 0xD800 || c > 0xDFFF) {
+    return c;
+  }
+  if (c <= 0xDBFF && i + 1 < len &&
+      chars[i + 1] >= 0xDC00 && chars[i + 1] <= 0xDFFF) {
+    *units = 2;
+    return 0x10000 + ((c - 0xD800) << 10) + (chars[i + 1] - 0xDC00);
+  }
+  return 0xFFFD;
+}
+
+inline size_t
+Utf8SequenceLength(uint32_t cp)
+{
+  if (cp < 0x80) {
+    return 1;
+  }
+  if (cp < 0x800) {
+    return 2;
+  }
+  return cp < 0x10000 ? 3 : 4;
+}
+
+inline void
+EncodeUtf8(uint32_t cp,
+           char* dst,
+           size_t bytes)
+{
+  static const unsigned char kLeadBits[] = { 0, 0, 0xC0, 0xE0, 0xF0 };
+  for (size_t i = bytes - 1; i > 0; i--) {
+    dst[i] = static_cast<char>(0x80 | (cp & 0x3F));
+    cp >>= 6;
+  }
+  dst[0] = static_cast<char>(kLeadBits[bytes] | cp);
+}
+
+size_t
+Utf8EncodedLength(const jschar* chars,
+                  size_t len)
+{
+  size_t bytes = 0;
+  size_t i = 0;
+  while (i < len) {
+#ifdef __SSE2__
+    if (chars[i] < 0x80 && i + kBlockUnits <= len &&
+        IsAsciiBlock(&chars[i])) {
+      bytes += kBlockUnits;
+      i += kBlockUnits;
+      continue;
+    }
+#endif
+    size_t units;
+    bytes += Utf8SequenceLength(DecodeCodePoint(chars, i, len, &units));
+    i += units;
+  }
+  return bytes;
+}
+
+} // anonymous namespace
+
 int
 String::Length() const
 {
@@ -107,9 +319,12 @@ String::Length() const
 int
 String::Utf8Length() const
 {
-  size_t encodedLength = JS_GetStringEncodingLength(cx(),
-                                                    *this);
-  return static_cast<int>(encodedLength);
+  size_t len;
+  const jschar* chars = JS_GetStringCharsZAndLength(cx(), *this, &len);
+  if (!chars) {
+    return 0;
+  }
+  return static_cast<int>(Utf8EncodedLength(chars, len));
 }
 
 int
@@ -121,16 +336,23 @@ String::Write(uint16_t* buffer,
   size_t internalLen;
   const jschar* chars =
     JS_GetStringCharsZAndLength(cx(), *this, &internalLen);
-  if (!chars || internalLen < static_cast<size_t>(start)) {
+  if (!chars) {
     return 0;
   }
-  size_t bytes = std::min<size_t>(length, internalLen - start) * sizeof(uint16_t);
-  if (length == -1) {
-    bytes = (internalLen - start) * sizeof(uint16_t);
+  int end = length;
+  if (length == -1 || length > static_cast<int>(internalLen) - start) {
+    end = static_cast<int>(internalLen) - start;
   }
-  (void)memcpy(buffer, &chars[start], bytes);
+  if (end < 0) {
+    return 0;
+  }
+  (void)memcpy(buffer, &chars[start], end * sizeof(uint16_t));
 
-  return bytes / 2;
+  // If we have enough space for the NULL terminator, set it.
+  if (length == -1 || end < length) {
+    buffer[end] = 0;
+  }
+  return end;
 }
 
 int
@@ -139,47 +361,26 @@ String::WriteAscii(char* buffer,
                    int length,
                    WriteHints hints) const
 {
-  size_t encodedLength = JS_GetStringEncodingLength(cx(),
-                                                    *this);
-  char* tmp = array_new<char>(encodedLength);
-  int written = WriteUtf8(tmp, encodedLength);
-
-  // No easy way to convert UTF-8 to ASCII, so just drop characters that are
-  // not ASCII.
-  int effectiveLength = length;
-  if (effectiveLength == -1) {
-    // Assume enough storage to fit the string + null
-    effectiveLength = written + 1;
-  }
-  int end = start + encodedLength;
-  // [start,end) is the range to read from
-  // [0, effectiveLength) is the range to write to
-  int i = 0;
-  for (int idx = start; i < effectiveLength && idx < end; i++, idx++) {
-    unsigned char first = static_cast<unsigned char>(tmp[idx]);
-    if (first > 0x7F) {
-      if (first < 0xE0) {
-        char second = tmp[++idx] & ~0x80;
-        unsigned int ch = (static_cast<unsigned int>(first & ~0xC0) << 6) | second;
-        if (ch == (0xff & ch)) {
-          buffer[i] = ch;
-          continue;
-        }
-        // Doesn't fit into a single byte, fall through
-      }
-      i--;
-      continue;
-    } else {
-      buffer[i] = tmp[idx];
-    }
+  size_t internalLen;
+  const jschar* chars =
+    JS_GetStringCharsZAndLength(cx(), *this, &internalLen);
+  if (!chars) {
+    return 0;
   }
-  // If we have enough space for the NULL terminator, set it.
-  if (i < effectiveLength) {
-    buffer[i] = '\0';
+  int end = length;
+  if (length == -1 || length > static_cast<int>(internalLen) - start) {
+    end = static_cast<int>(internalLen) - start;
+  }
+  if (end < 0) {
+    return 0;
   }
+  NarrowToLatin1(&chars[start], buffer, end);
 
-  array_delete(tmp);
-  return i;
+  // If we have enough space for the NULL terminator, set it.
+  if (length == -1 || end < length) {
+    buffer[end] = '\0';
+  }
+  return end;
 }
 
 int
@@ -188,20 +389,50 @@ String::WriteUtf8(char* buffer,
                   int* nchars_ref,
                   WriteHints hints) const
 {
-  // TODO handle -1 for length!
-  size_t bytesWritten = JS_EncodeStringToBuffer(*this, buffer, length);
+  size_t internalLen;
+  const jschar* chars =
+    JS_GetStringCharsZAndLength(cx(), *this, &internalLen);
+  if (!chars) {
+    if (nchars_ref) {
+      *nchars_ref = 0;
+    }
+    return 0;
+  }
+  size_t capacity = length == -1 ? size_t(-1) : static_cast<size_t>(length);
 
-  // If we have enough space for the NULL terminator, set it.
-  if (bytesWritten < size_t(length)) {
-    buffer[bytesWritten++] = '\0';
+  // Only whole characters are written, so a surrogate pair or multi-byte
+  // sequence that does not fit stops the copy short of the capacity.
+  size_t i = 0;
+  size_t pos = 0;
+  while (i < internalLen && pos < capacity) {
+    if (chars[i] < 0x80) {
+      size_t n = CopyAsciiPrefix(&chars[i], &buffer[pos],
+                                 std::min(internalLen - i, capacity - pos));
+      i += n;
+      pos += n;
+      continue;
+    }
+    size_t units;
+    uint32_t cp = DecodeCodePoint(chars, i, internalLen, &units);
+    size_t bytes = Utf8SequenceLength(cp);
+    if (bytes > capacity - pos) {
+      break;
+    }
+    EncodeUtf8(cp, &buffer[pos], bytes);
+    i += units;
+    pos += bytes;
+  }
+
+  // If we wrote the whole string and have room for the NULL terminator, set
+  // it.
+  if (i == internalLen && pos < capacity) {
+    buffer[pos++] = '\0';
   }
 
-  // TODO check to make sure we don't overflow int
   if (nchars_ref) {
-    // XXX This works when the whole string fits in length, but not if it's less
-    *nchars_ref = this->Length();
+    *nchars_ref = static_cast<int>(i);
   }
-  return static_cast<int>(bytesWritten);
+  return static_cast<int>(pos);
 }
 
 // static
@@ -236,6 +467,30 @@ String::AsciiValue::~AsciiValue()
     array_delete(mStr);
 }
 
+String::Value::Value(Handle<v8::Value> val)
+{
+  // Set some defaults which will be used for empty values/strings
+  mStr = NULL;
+  mLength = 0;
+
+  if (val.IsEmpty()) {
+    return;
+  }
+
+  Local<String> str = val->ToString();
+  if (!str.IsEmpty()) {
+    int len = str->Length();
+    // Need space for the NULL terminator.
+    mStr = array_new<uint16_t>(len + 1);
+    mLength = str->Write(mStr, 0, len + 1);
+  }
+}
+String::Value::~Value()
+{
+  if (mStr)
+    array_delete(mStr);
+}
+
 String::Utf8Value::Utf8Value(Handle<v8::Value> val)
 {
   // Set some defaults which will be used for empty values/strings
@@ -249,7 +504,14 @@ String::Utf8Value::Utf8Value(Handle<v8::Value> val)
   // TODO: Do we need something about HandleScope here?
   Local<String> str = val->ToString();
   if (!str.IsEmpty()) {
-    int len = str->Utf8Length();
+    // Short strings are encoded straight into a worst-case buffer; longer
+    // ones are measured first so we don't triple the allocation.
+    int len = str->Length();
+    if (len > kUtf8ValueSinglePassLength) {
+      len = str->Utf8Length();
+    } else {
+      len *= kMaxUtf8BytesPerUnit;
+    }
     // Need space for the NULL terminator.
     mStr = array_new<char>(len + 1);
     mLength = str->WriteUtf8(mStr, len + 1) - 1;
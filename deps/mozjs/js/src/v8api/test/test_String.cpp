@@ -16,6 +16,58 @@ fill_string(char* buf,
   }
 }
 
+class TwoByteResource : public String::ExternalStringResource {
+public:
+  static int dispose_count;
+
+  TwoByteResource(const uint16_t* data, size_t length, bool terminated) :
+    mData(data),
+    mLength(length),
+    mTerminated(terminated)
+  {
+  }
+
+  ~TwoByteResource() {
+    ++dispose_count;
+  }
+
+  const uint16_t* data() const {
+    return mData;
+  }
+
+  size_t length() const {
+    return mLength;
+  }
+
+  bool IsTerminated() const {
+    return mTerminated;
+  }
+private:
+  const uint16_t* mData;
+  size_t mLength;
+  bool mTerminated;
+};
+
+int TwoByteResource::dispose_count = 0;
+
+static const uint16_t kTwoByteSource[] = {
+  '1', ' ', '+', ' ', '2', ' ', '*', ' ', '3', 0
+};
+
+static Handle<Value>
+run_external(const uint16_t* data,
+             size_t length,
+             bool terminated,
+             bool expect_external)
+{
+  HandleScope scope;
+  Local<String> source =
+    String::NewExternal(new TwoByteResource(data, length, terminated));
+  do_check_eq(source->IsExternal(), expect_external);
+  do_check_eq(source->Length(), static_cast<int>(length));
+  return scope.Close(Script::Compile(source)->Run());
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Tests
 
@@ -172,6 +224,27 @@ test_AsciiValue_length()
   context.Dispose();
 }
 
+void
+test_Value_twoByte()
+{
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  const uint16_t TEST_STRING[] = { 'p', 'i', ':', ' ', 0x03c0, 0xd83d, 0xde00 };
+  const int TEST_LENGTH = sizeof(TEST_STRING) / sizeof(TEST_STRING[0]);
+  Handle<String> str = String::New(TEST_STRING, TEST_LENGTH);
+  String::Value value(str);
+  do_check_eq(value.length(), TEST_LENGTH);
+  do_check_true(0 == memcmp(*value, TEST_STRING, sizeof(TEST_STRING)));
+  do_check_eq((*value)[TEST_LENGTH], 0);
+
+  String::Value empty((Handle<Value>()));
+  do_check_eq(empty.length(), 0);
+  do_check_true(*empty == NULL);
+  context.Dispose();
+}
+
 void
 test_Utf8Value_length()
 {
@@ -218,6 +291,124 @@ test_PartialWriteAscii() {
   context.Dispose();
 }
 
+void
+test_NewExternalTwoByte() {
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  // Data promised to be NUL-terminated is used in place and disposed with
+  // the string.
+  TwoByteResource::dispose_count = 0;
+  Handle<Value> value = run_external(kTwoByteSource, 9, true, true);
+  do_check_eq(value->Int32Value(), 7);
+  do_check_eq(TwoByteResource::dispose_count, 0);
+  for (int i = 0; i < 10 && TwoByteResource::dispose_count == 0; i++) {
+    JS_GC(i::cx());
+  }
+  do_check_eq(TwoByteResource::dispose_count, 1);
+
+  // Anything else is copied and the resource is released right away, even
+  // when a NUL happens to follow the data.
+  TwoByteResource::dispose_count = 0;
+  value = run_external(kTwoByteSource, 5, false, false);
+  do_check_eq(value->Int32Value(), 3);
+  do_check_eq(TwoByteResource::dispose_count, 1);
+  TwoByteResource::dispose_count = 0;
+  value = run_external(kTwoByteSource, 9, false, false);
+  do_check_eq(value->Int32Value(), 7);
+  do_check_eq(TwoByteResource::dispose_count, 1);
+  context.Dispose();
+}
+
+void
+test_WriteUtf8Capacity() {
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  // abc<Icelandic eth><Unicode snowman>.
+  Handle<String> str = String::New("abc\303\260\342\230\203");
+  struct {
+    int capacity;
+    int written;
+    int chars;
+  } cases[] = {
+    { 100, 9, 5 },
+    { -1, 9, 5 },
+    { 8, 8, 5 },
+    { 7, 5, 4 },
+    { 5, 5, 4 },
+    { 4, 3, 3 },
+    { 2, 2, 2 },
+  };
+  char buf[16];
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    fill_string(buf, '\1', sizeof(buf));
+    int charsWritten;
+    int written = str->WriteUtf8(buf, cases[i].capacity, &charsWritten);
+    do_check_eq(written, cases[i].written);
+    do_check_eq(charsWritten, cases[i].chars);
+    do_check_eq(buf[written], '\1');
+  }
+  do_check_eq(str->Utf8Length(), 8);
+
+  // Surrogate pairs become one four byte sequence and are never split; a lone
+  // surrogate is replaced.
+  const uint16_t pair[] = { 'a', 0xD834, 0xDD1E, 0xDC00, 0 };
+  str = String::New(pair);
+  do_check_eq(str->Utf8Length(), 8);
+  fill_string(buf, '\1', sizeof(buf));
+  int charsWritten;
+  do_check_eq(str->WriteUtf8(buf, -1, &charsWritten), 9);
+  do_check_eq(charsWritten, 4);
+  do_check_eq(strcmp(buf, "a\360\235\204\236\357\277\275"), 0);
+  do_check_eq(str->WriteUtf8(buf, 4, &charsWritten), 1);
+  do_check_eq(charsWritten, 1);
+  context.Dispose();
+}
+
+void
+test_WriteLongStrings() {
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  // Move a single non-ASCII character through a string long enough to use
+  // the block copies, so every alignment of the fast path is covered.
+  const int length = 100;
+  uint16_t chars[length + 1];
+  char buf[length * 3 + 1];
+  for (int special = 0; special < length; special++) {
+    for (int i = 0; i < length; i++) {
+      chars[i] = 'a' + i % 26;
+    }
+    chars[special] = 0x3C0; // π
+    chars[length] = 0;
+    Handle<String> str = String::New(chars, length);
+
+    do_check_eq(str->Utf8Length(), length + 1);
+    int charsWritten;
+    do_check_eq(str->WriteUtf8(buf, sizeof(buf), &charsWritten), length + 2);
+    do_check_eq(charsWritten, length);
+    do_check_eq(buf[special], '\317');
+    do_check_eq(buf[special + 1], '\200');
+    char last = special == length - 1 ? '\200' : 'a' + (length - 1) % 26;
+    do_check_eq(buf[length], last);
+
+    // Latin-1 keeps the low byte of every character.
+    chars[(special + 1) % length] = 0;
+    str = String::New(chars, length);
+    do_check_eq(str->WriteAscii(buf), length);
+    do_check_eq(strlen(buf), size_t(length));
+    do_check_eq(buf[special], '\300');
+    do_check_eq(buf[(special + 1) % length], ' ');
+    int next = (special + 2) % length;
+    do_check_eq(buf[next], char('a' + next % 26));
+  }
+  context.Dispose();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Test Harness
 
@@ -232,6 +423,10 @@ Test gTests[] = {
   TEST(test_Utf8Value_length),
   TEST(test_WriteAsciiEmpty),
   TEST(test_PartialWriteAscii),
+  TEST(test_NewExternalTwoByte),
+  TEST(test_WriteUtf8Capacity),
+  TEST(test_WriteLongStrings),
+  TEST(test_Value_twoByte),
 };
 
 const char* file = __FILE__;
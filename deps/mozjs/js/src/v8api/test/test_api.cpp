@@ -1621,9 +1621,34 @@ test_FunctionCall()
 }
 
 // from test-api.cc:2012
+static int gFatalErrors = 0;
+static void CountFatalError(const char* location, const char* message) {
+  gFatalErrors++;
+}
+
 void
 test_OutOfMemory()
-{ }
+{
+  static const int K = 1024;
+  v8::ResourceConstraints constraints;
+  constraints.set_max_old_space_size(4 * K * K);
+  CHECK(v8::SetResourceConstraints(&constraints));
+  v8::V8::SetFatalErrorHandler(CountFatalError);
+  gFatalErrors = 0;
+
+  {
+    v8::HandleScope scope;
+    LocalContext context;
+    v8::TryCatch try_catch;
+    Local<Value> result = CompileRun("var a = []; while (true) a.push(a);");
+    CHECK(result.IsEmpty());
+    CHECK_EQ(1, gFatalErrors);
+  }
+
+  v8::V8::SetFatalErrorHandler(NULL);
+  constraints.set_max_old_space_size(64 * K * K);
+  CHECK(v8::SetResourceConstraints(&constraints));
+}
 
 // from test-api.cc:2053
 void
@@ -4446,9 +4471,43 @@ test_IdleNotification()
 }
 
 // from test-api.cc:11736
+static uint32_t* ComputeStackLimit(uint32_t size) {
+  uint32_t* answer = &size - (size / sizeof(size));
+  // If the size is very large and the stack is very near the bottom of
+  // memory then the calculation above may wrap around and give an address
+  // that is above the (downwards-growing) stack.  In that case we return
+  // a very low address.
+  if (answer > &size) return reinterpret_cast<uint32_t*>(sizeof(size));
+  return answer;
+}
+
 void
 test_SetResourceConstraints()
-{ }
+{
+  static const int K = 1024;
+  v8::ResourceConstraints constraints;
+  constraints.set_stack_limit(ComputeStackLimit(128 * K));
+  CHECK(v8::SetResourceConstraints(&constraints));
+
+  v8::HandleScope scope;
+  LocalContext env;
+  CompileRun("function recurse(n) { return n ? recurse(n - 1) + 1 : 0; }");
+  {
+    v8::TryCatch try_catch;
+    Local<Value> result = CompileRun("recurse(100)");
+    CHECK_EQ(100, result->Int32Value());
+  }
+  {
+    // Running off the end of the allowed stack is an ordinary exception.
+    v8::TryCatch try_catch;
+    Local<Value> result = CompileRun("recurse(1e6)");
+    CHECK(result.IsEmpty());
+    CHECK(try_catch.HasCaught());
+  }
+
+  constraints.set_stack_limit(ComputeStackLimit(4 * K * K));
+  CHECK(v8::SetResourceConstraints(&constraints));
+}
 
 // from test-api.cc:11758
 void
@@ -4576,9 +4635,68 @@ test_Bug618()
 }
 
 // from test-api.cc:12243
+int prologue_call_count = 0;
+int epilogue_call_count = 0;
+int prologue_call_count_second = 0;
+int epilogue_call_count_second = 0;
+
+void PrologueCallback(v8::GCType, v8::GCCallbackFlags) {
+  ++prologue_call_count;
+}
+
+void EpilogueCallback(v8::GCType, v8::GCCallbackFlags) {
+  ++epilogue_call_count;
+}
+
+void PrologueCallbackSecond(v8::GCType, v8::GCCallbackFlags) {
+  ++prologue_call_count_second;
+}
+
+void EpilogueCallbackSecond(v8::GCType, v8::GCCallbackFlags) {
+  ++epilogue_call_count_second;
+}
+
 void
 test_GCCallbacks()
-{ }
+{
+  LocalContext context;
+
+  v8::V8::AddGCPrologueCallback(PrologueCallback);
+  v8::V8::AddGCEpilogueCallback(EpilogueCallback);
+  CHECK_EQ(0, prologue_call_count);
+  CHECK_EQ(0, epilogue_call_count);
+  i::Heap::CollectAllGarbage(false);
+  CHECK_EQ(1, prologue_call_count);
+  CHECK_EQ(1, epilogue_call_count);
+  v8::V8::AddGCPrologueCallback(PrologueCallbackSecond);
+  v8::V8::AddGCEpilogueCallback(EpilogueCallbackSecond);
+  i::Heap::CollectAllGarbage(false);
+  CHECK_EQ(2, prologue_call_count);
+  CHECK_EQ(2, epilogue_call_count);
+  CHECK_EQ(1, prologue_call_count_second);
+  CHECK_EQ(1, epilogue_call_count_second);
+  v8::V8::RemoveGCPrologueCallback(PrologueCallback);
+  v8::V8::RemoveGCEpilogueCallback(EpilogueCallback);
+  i::Heap::CollectAllGarbage(false);
+  CHECK_EQ(2, prologue_call_count);
+  CHECK_EQ(2, epilogue_call_count);
+  CHECK_EQ(2, prologue_call_count_second);
+  CHECK_EQ(2, epilogue_call_count_second);
+  v8::V8::RemoveGCPrologueCallback(PrologueCallbackSecond);
+  v8::V8::RemoveGCEpilogueCallback(EpilogueCallbackSecond);
+  i::Heap::CollectAllGarbage(false);
+  CHECK_EQ(2, prologue_call_count);
+  CHECK_EQ(2, epilogue_call_count);
+  CHECK_EQ(2, prologue_call_count_second);
+  CHECK_EQ(2, epilogue_call_count_second);
+
+  // Not in test-api.cc: scavenges never happen here, so a callback that
+  // asks only for those is never called.
+  v8::V8::AddGCPrologueCallback(PrologueCallback, v8::kGCTypeScavenge);
+  i::Heap::CollectAllGarbage(false);
+  CHECK_EQ(2, prologue_call_count);
+  v8::V8::RemoveGCPrologueCallback(PrologueCallback);
+}
 
 // from test-api.cc:12277
 void
@@ -4814,7 +4932,7 @@ Test gTests[] = {
   TEST(test_Array),
   TEST(test_Vector),
   TEST(test_FunctionCall),
-  UNIMPLEMENTED_TEST(test_OutOfMemory),
+  TEST(test_OutOfMemory),
   UNIMPLEMENTED_TEST(test_OutOfMemoryNested),
   UNIMPLEMENTED_TEST(test_HugeConsStringOutOfMemory),
   UNIMPLEMENTED_TEST(test_ConstructCall),
@@ -5058,8 +5176,8 @@ Test gTests[] = {
   UNIMPLEMENTED_TEST(test_CaptureStackTraceForUncaughtException),
   UNIMPLEMENTED_TEST(test_CaptureStackTraceForUncaughtExceptionAndSetters),
   UNIMPLEMENTED_TEST(test_SourceURLInStackTrace),
-  DISABLED_TEST(test_IdleNotification, 24),
-  UNIMPLEMENTED_TEST(test_SetResourceConstraints),
+  TEST(test_IdleNotification),
+  TEST(test_SetResourceConstraints),
   UNIMPLEMENTED_TEST(test_SetResourceConstraintsInThread),
   UNIMPLEMENTED_TEST(test_GetHeapStatistics),
   UNIMPLEMENTED_TEST(test_QuietSignalingNaNs),
@@ -5070,7 +5188,7 @@ Test gTests[] = {
   TEST(test_SetterOnConstructorPrototype),
   UNIMPLEMENTED_TEST(test_InterceptorOnConstructorPrototype),
   TEST(test_Bug618),
-  UNIMPLEMENTED_TEST(test_GCCallbacks),
+  TEST(test_GCCallbacks),
   UNIMPLEMENTED_TEST(test_AddToJSFunctionResultCache),
   UNIMPLEMENTED_TEST(test_FillJSFunctionResultCache),
   UNIMPLEMENTED_TEST(test_RoundRobinGetFromCache),
@@ -166,6 +166,87 @@ test_NestedException()
   context.Dispose();
 }
 
+void
+test_ArgumentCounts()
+{
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  Local<Script> script = Script::Compile(String::New(
+    "(function() {"
+    "  var sum = 0;"
+    "  for (var i = 0; i < arguments.length; i++) sum += arguments[i];"
+    "  return sum * 100 + arguments.length;"
+    "})"));
+  Local<Function> fn = script->Run().As<Function>();
+
+  // Both sides of the inline argument buffer, and a constructor call.
+  const int counts[] = { 0, 1, 8, 9, 32 };
+  Handle<Value> args[32];
+  for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); c++) {
+    int sum = 0;
+    for (int i = 0; i < counts[c]; i++) {
+      args[i] = Integer::New(i);
+      sum += i;
+    }
+    Local<Value> v = fn->Call(context->Global(), counts[c], args);
+    do_check_eq(v->Int32Value(), sum * 100 + counts[c]);
+  }
+  Local<Object> o = fn->NewInstance(9, args);
+  do_check_true(o->IsObject());
+  context.Dispose();
+}
+
+Handle<Value> StoreValue(const Arguments& args) {
+  args.This()->SetInternalField(0, args[0]);
+  return Undefined();
+}
+
+Handle<Value> GetStoredValue(Local<String> property, const AccessorInfo& info) {
+  return info.Holder()->GetInternalField(0);
+}
+
+static bool
+RunBool(const char* source)
+{
+  Local<Script> script = Script::Compile(String::New(source));
+  return script->Run()->BooleanValue();
+}
+
+void
+test_ConstructorPrototype()
+{
+  HandleScope handle_scope;
+  Handle<FunctionTemplate> fnT = FunctionTemplate::New(StoreValue);
+  fnT->InstanceTemplate()->SetInternalFieldCount(1);
+  fnT->InstanceTemplate()->SetAccessor(String::New("value"), GetStoredValue);
+  Handle<ObjectTemplate> templ = ObjectTemplate::New();
+  templ->Set("Thing", fnT);
+
+  Persistent<Context> context = Context::New(NULL, templ);
+  Context::Scope context_scope(context);
+
+  (void)RunBool("var a = new Thing(1), b = new Thing(2);");
+  do_check_true(RunBool("Object.getPrototypeOf(a) === Thing.prototype"));
+  do_check_true(RunBool("Object.getPrototypeOf(b) === Thing.prototype"));
+  do_check_true(RunBool("a instanceof Thing"));
+  do_check_true(fnT->HasInstance(context->Global()->Get(String::New("a"))));
+
+  // Instances share their accessor functions but each reads its own holder,
+  // also when reached through the prototype chain.
+  do_check_true(RunBool("a.value === 1 && b.value === 2"));
+  do_check_true(RunBool("Object.create(b).value === 2"));
+  do_check_true(RunBool("a.__lookupGetter__('value') === "
+                        "b.__lookupGetter__('value')"));
+
+  // Constructors pick up changes to their prototype property.
+  do_check_true(RunBool("Thing.prototype.extra = 5; a.extra === 5"));
+  do_check_true(RunBool("Thing.prototype = { k: 3 }; "
+                        "var c = new Thing(3); c.k === 3 && c.value === 3"));
+  context.Dispose();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Test Harness
 
@@ -176,6 +257,8 @@ Test gTests[] = {
   TEST(test_Name),
   TEST(test_Exception),
   TEST(test_NestedException),
+  TEST(test_ArgumentCounts),
+  TEST(test_ConstructorPrototype),
 };
 
 const char* file = __FILE__;
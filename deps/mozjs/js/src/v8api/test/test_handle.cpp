@@ -3,6 +3,8 @@
 
 #include "v8api_test_harness.h"
 
+#include <limits.h>
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Tests
 
@@ -33,12 +35,417 @@ test_HandleScope() {
   do_check_true(s->Equals(v));
 }
 
+void
+test_HandleScopeSurvivesGC() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  // Enough handles to spill over several arena slabs.
+  const int kCount = 5000;
+  Local<String> first = String::New("first");
+  Local<Object> objects[kCount];
+  Local<Value> last;
+  {
+    HandleScope inner;
+    for (int i = 0; i < kCount; i++) {
+      objects[i] = Object::New();
+      objects[i]->Set(String::New("index"), Integer::New(i));
+    }
+    last = inner.Close(objects[kCount - 1]);
+  }
+
+  // Reopening a scope reuses the slabs without disturbing older handles.
+  {
+    HandleScope inner;
+    for (int i = 0; i < kCount; i++) {
+      objects[i] = Object::New();
+      objects[i]->Set(String::New("index"), Integer::New(i));
+    }
+    JS_GC(i::cx());
+    for (int i = 0; i < kCount; i++) {
+      (void)String::New("filler");
+    }
+    bool intact = true;
+    for (int i = 0; i < kCount; i++) {
+      intact = intact && objects[i]->Get(String::New("index"))->Int32Value() == i;
+    }
+    do_check_true(intact);
+  }
+  do_check_true(first->Equals(String::New("first")));
+  do_check_eq(last->ToObject()->Get(String::New("index"))->Int32Value(), kCount - 1);
+  context.Dispose();
+}
+
+void
+test_DisposeForeignReference() {
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  // The booleans are statics, not arena slots, and must survive a Dispose.
+  Persistent<Boolean> t(*True());
+  t.Dispose();
+  do_check_true(True()->Value());
+
+  // Disposing a local is a no-op; the scope still owns it.
+  Local<String> s = String::New("local");
+  Persistent<String> p(*s);
+  p.Dispose();
+  do_check_true(s->Equals(String::New("local")));
+
+  Persistent<String> real = Persistent<String>::New(s);
+  do_check_true(real->Equals(s));
+  real.Dispose();
+  context.Dispose();
+}
+
+static int gWeakCallbacks = 0;
+
+static void
+WeakCallback(Persistent<Value> object, void *parameter)
+{
+  gWeakCallbacks++;
+  object.Dispose();
+}
+
+void
+test_WeakHandleStatistics() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  const int kCount = 100;
+  Persistent<Object> kept = Persistent<Object>::New(Object::New());
+  kept.MakeWeak(NULL, WeakCallback);
+  {
+    HandleScope inner;
+    for (int i = 0; i < kCount; i++) {
+      Persistent<Object> p = Persistent<Object>::New(Object::New());
+      p.MakeWeak(NULL, WeakCallback);
+      do_check_true(p.IsWeak());
+    }
+    Persistent<Value> primitive = Persistent<Value>::New(Integer::New(5));
+    primitive.MakeWeak(NULL, WeakCallback);
+    primitive.ClearWeak();
+    do_check_false(primitive.IsWeak());
+    primitive.Dispose();
+  }
+
+  HeapStatistics stats;
+  V8::GetHeapStatistics(&stats);
+  do_check_eq(stats.number_of_weak_handles(), size_t(kCount + 1));
+
+  kept.ClearWeak();
+  JS_GC(i::cx());
+  V8::GetHeapStatistics(&stats);
+  do_check_eq(gWeakCallbacks, kCount);
+  do_check_eq(stats.weak_callbacks_last_gc(), size_t(kCount));
+  do_check_eq(stats.number_of_weak_handles(), size_t(0));
+  do_check_true(kept->IsObject());
+  kept.Dispose();
+
+  // Reuse every freed entry and then run past the end of the free list.
+  {
+    HandleScope inner;
+    for (int i = 0; i < kCount + 2; i++) {
+      Persistent<Object> p = Persistent<Object>::New(Object::New());
+      p.MakeWeak(NULL, WeakCallback);
+    }
+  }
+  V8::GetHeapStatistics(&stats);
+  do_check_eq(stats.number_of_weak_handles(), size_t(kCount + 2));
+  context.Dispose();
+}
+
+static JSObject* gOtherGlobal = NULL;
+static Persistent<Value> gOtherHandle;
+static int gOtherCallbacks = 0;
+
+static void
+OtherCompartmentCallback(Persistent<Value> object, void *parameter)
+{
+  gOtherCallbacks++;
+  object.Dispose();
+}
+
+static void
+WeakCallbackAddingTable(Persistent<Value> object, void *parameter)
+{
+  gOtherCallbacks++;
+  object.Dispose();
+  // No weak handle points into the other compartment yet, so this adds its
+  // table while the collection is sweeping the others.
+  gOtherHandle.MakeWeak(NULL, OtherCompartmentCallback);
+}
+
+// Out of line, so that no copy of the other global is left in this frame for
+// the conservative stack scanner to find.
+static JS_NEVER_INLINE void
+MakeOtherCompartment()
+{
+  static JSClass global_class = {
+    "global", JSCLASS_GLOBAL_FLAGS,
+    JS_PropertyStub, JS_PropertyStub, JS_PropertyStub, JS_StrictPropertyStub,
+    JS_EnumerateStub, JS_ResolveStub, JS_ConvertStub, JS_FinalizeStub,
+    JSCLASS_NO_OPTIONAL_MEMBERS
+  };
+  gOtherGlobal = JS_NewCompartmentAndGlobalObject(i::cx(), &global_class, NULL);
+  do_check_true(gOtherGlobal != NULL);
+  JS_AddObjectRoot(i::cx(), &gOtherGlobal);
+  Value global(OBJECT_TO_JSVAL(gOtherGlobal));
+  gOtherHandle = Persistent<Value>::New(Handle<Value>(&global));
+}
+
+static JS_NEVER_INLINE void
+ScribbleOverStack()
+{
+  volatile char scratch[16 * 1024];
+  memset(const_cast<char*>(scratch), 0, sizeof(scratch));
+}
+
+void
+test_WeakHandleTablesFollowCompartments() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  i::WeakHandleTableMap &tables = i::isolate()->weakHandleTables;
+  MakeOtherCompartment();
+
+  {
+    HandleScope inner;
+    Persistent<Object> p = Persistent<Object>::New(Object::New());
+    p.MakeWeak(NULL, WeakCallbackAddingTable);
+  }
+  size_t before = tables.count();
+  JS_GC(i::cx());
+  do_check_eq(gOtherCallbacks, 1);
+  do_check_true(gOtherHandle.IsWeak());
+  do_check_eq(tables.count(), before + 1);
+
+  // Once the other compartment is collected, its table goes with it.
+  JS_RemoveObjectRoot(i::cx(), &gOtherGlobal);
+  gOtherGlobal = NULL;
+  ScribbleOverStack();
+  JS_GC(i::cx());
+  do_check_eq(gOtherCallbacks, 2);
+  do_check_eq(tables.count(), before);
+  context.Dispose();
+}
+
+static void
+MakeWeakGarbage(int count)
+{
+  HandleScope inner;
+  for (int i = 0; i < count; i++) {
+    Persistent<Object> p = Persistent<Object>::New(Object::New());
+    p.MakeWeak(NULL, WeakCallback);
+  }
+  // Allocate well past the growth IdleNotification ignores.
+  for (int i = 0; i < 20000; i++) {
+    Object::New()->Set(String::New("index"), Integer::New(i));
+  }
+}
+
+void
+test_IdleNotificationCollects() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  const int kCount = 100;
+  JS_GC(i::cx());
+  gWeakCallbacks = 0;
+  MakeWeakGarbage(kCount);
+
+  bool done = false;
+  int calls = 0;
+  while (!done && calls < 10) {
+    done = V8::IdleNotification();
+    calls++;
+  }
+  do_check_true(done);
+  do_check_eq(gWeakCallbacks, kCount);
+
+  // With nothing allocated since, there is no more work to do.
+  do_check_true(V8::IdleNotification());
+  context.Dispose();
+}
+
+void
+test_IdleNotificationBudget() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  // Give the engine a collection to time, then leave garbage around that
+  // a zero budget is too small to collect.
+  JS_GC(i::cx());
+  gWeakCallbacks = 0;
+  MakeWeakGarbage(10);
+  do_check_true(V8::IdleNotification(0));
+  do_check_eq(gWeakCallbacks, 0);
+
+  do_check_false(V8::IdleNotification(1000));
+  do_check_eq(gWeakCallbacks, 10);
+  context.Dispose();
+}
+
+void
+test_LowMemoryNotification() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  const int kCount = 100;
+  JS_GC(i::cx());
+  gWeakCallbacks = 0;
+  MakeWeakGarbage(kCount);
+  V8::LowMemoryNotification();
+  do_check_eq(gWeakCallbacks, kCount);
+  do_check_true(V8::IdleNotification());
+  context.Dispose();
+}
+
+void
+test_ExternalMemoryTriggersGC() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  const int kExternal = 128 * 1024 * 1024;
+  JS_GC(i::cx());
+  gWeakCallbacks = 0;
+  MakeWeakGarbage(10);
+  int before = V8::AdjustAmountOfExternalAllocatedMemory(0);
+
+  // Reporting more than the malloc limit makes the next chance to collect
+  // take it, however little the GC heap itself has grown.
+  int total = V8::AdjustAmountOfExternalAllocatedMemory(kExternal);
+  do_check_eq(total, before + kExternal);
+  JS_MaybeGC(i::cx());
+  do_check_eq(gWeakCallbacks, 10);
+
+  total = V8::AdjustAmountOfExternalAllocatedMemory(-kExternal);
+  do_check_eq(total, before);
+
+  // Past 2 GB the total saturates instead of wrapping, and comes back down
+  // intact.
+  V8::AdjustAmountOfExternalAllocatedMemory(INT_MAX);
+  total = V8::AdjustAmountOfExternalAllocatedMemory(INT_MAX);
+  do_check_eq(total, INT_MAX);
+  V8::AdjustAmountOfExternalAllocatedMemory(-INT_MAX);
+  total = V8::AdjustAmountOfExternalAllocatedMemory(-INT_MAX);
+  do_check_eq(total, before);
+  context.Dispose();
+}
+
+void
+test_HeapStatistics() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  HeapStatistics stats;
+  V8::GetHeapStatistics(&stats);
+  size_t used = stats.used_heap_size();
+  size_t total = stats.total_heap_size();
+  size_t limit = stats.heap_size_limit();
+  do_check_true(used > 0);
+  do_check_true(used <= total);
+  do_check_true(total <= limit);
+  context.Dispose();
+}
+
+void
+test_CompartmentHeapStatistics() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  Local<Array> strings = Array::New();
+  for (int i = 0; i < 1000; i++) {
+    strings->Set(i, String::Concat(String::New("string "), Integer::New(i)->ToString()));
+  }
+  Script::Compile(String::New("var answer = 42;"))->Run();
+
+  CompartmentHeapStatistics* stats;
+  size_t count = V8::GetCompartmentHeapStatistics(&stats);
+  do_check_true(count >= 2);
+  do_check_true(stats != NULL);
+
+  CompartmentHeapStatistics* main = NULL;
+  bool sawAtoms = false;
+  for (size_t i = 0; i < count; i++) {
+    if (!strcmp(stats[i].name(), "main"))
+      main = &stats[i];
+    sawAtoms = sawAtoms || !strcmp(stats[i].name(), "atoms");
+  }
+  do_check_true(sawAtoms);
+  do_check_true(main != NULL);
+  size_t strings_size = main->strings_size();
+  do_check_true(strings_size > 1000 * 16);
+  do_check_true(main->objects_size() > 0);
+  do_check_true(main->shapes_size() > 0);
+  do_check_true(main->scripts_size() > 0);
+
+  delete[] stats;
+  context.Dispose();
+}
+
+void
+test_GCStatistics() {
+  HandleScope outer;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  GCStatistics before;
+  V8::GetGCStatistics(&before);
+  MakeWeakGarbage(100);
+  JS_GC(i::cx());
+  JS_GC(i::cx());
+
+  GCStatistics after;
+  V8::GetGCStatistics(&after);
+  do_check_eq(after.count(), before.count() + 2);
+  uint64_t last = after.last_pause();
+  uint64_t max = after.max_pause();
+  do_check_true(max >= last);
+  do_check_true(after.total_pause() >= before.total_pause() + last);
+
+  // Mark and sweep happen inside the pause and don't overlap.
+  uint64_t markAndSweep = after.last_phase_time(kGCPhaseMark) +
+                          after.last_phase_time(kGCPhaseSweep);
+  do_check_true(markAndSweep <= last);
+  uint64_t sweep = after.phase_time(kGCPhaseSweep);
+  do_check_true(sweep >= after.last_phase_time(kGCPhaseSweep));
+
+  size_t histogramTotal = 0;
+  for (int i = 0; i < GCStatistics::kHistogramBuckets; i++) {
+    histogramTotal += after.histogram(i);
+  }
+  do_check_eq(histogramTotal, after.count());
+  context.Dispose();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Test Harness
 
 Test gTests[] = {
   TEST(test_ArrayConversion),
   TEST(test_HandleScope),
+  TEST(test_HandleScopeSurvivesGC),
+  TEST(test_DisposeForeignReference),
+  TEST(test_WeakHandleStatistics),
+  TEST(test_WeakHandleTablesFollowCompartments),
+  TEST(test_IdleNotificationCollects),
+  TEST(test_IdleNotificationBudget),
+  TEST(test_LowMemoryNotification),
+  TEST(test_ExternalMemoryTriggersGC),
+  TEST(test_HeapStatistics),
+  TEST(test_CompartmentHeapStatistics),
+  TEST(test_GCStatistics),
 };
 
 const char* file = __FILE__;
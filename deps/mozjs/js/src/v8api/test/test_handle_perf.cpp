@@ -0,0 +1,69 @@
+/* Any copyright is dedicated to the Public Domain.
+   http://creativecommons.org/publicdomain/zero/1.0/ */
+
+#include "v8api_test_harness.h"
+#include "prmjtime.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//// Helpers
+
+static const int kScopeDepth = 50;
+static const int kPersistentCount = 1000000;
+static const int kBatchSize = 1000;
+
+static void
+DisposePersistents(int depth)
+{
+  HandleScope scope;
+  Local<Value> local = Integer::New(depth);
+  if (depth < kScopeDepth) {
+    DisposePersistents(depth + 1);
+    return;
+  }
+
+  Persistent<Value> batch[kBatchSize];
+  int64_t start = PRMJ_Now();
+  for (int i = 0; i < kPersistentCount; i += kBatchSize) {
+    for (int j = 0; j < kBatchSize; j++) {
+      batch[j] = Persistent<Value>::New(local);
+    }
+    for (int j = 0; j < kBatchSize; j++) {
+      batch[j].Dispose();
+    }
+  }
+  int64_t elapsed = PRMJ_Now() - start;
+  (void)printf("TEST-INFO | %d persistents disposed under %d scopes in %lld ms\n",
+               kPersistentCount, kScopeDepth,
+               (long long)(elapsed / PRMJ_USEC_PER_MSEC));
+
+  // Disposing a local is a no-op and must leave the handle intact.
+  Persistent<Value> notPersistent(*local);
+  notPersistent.Dispose();
+  do_check_eq(local->Int32Value(), depth);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// Tests
+
+void
+test_DisposeUnderNestedScopes()
+{
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  DisposePersistents(0);
+  context.Dispose();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// Test Harness
+
+Test gTests[] = {
+  TEST(test_DisposeUnderNestedScopes),
+};
+
+const char* file = __FILE__;
+#define TEST_NAME "Handle Performance"
+#define TEST_FILE file
+#include "v8api_test_harness_tail.h"
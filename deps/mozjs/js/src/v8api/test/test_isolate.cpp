@@ -0,0 +1,156 @@
+/* Any copyright is dedicated to the Public Domain.
+   http://creativecommons.org/publicdomain/zero/1.0/ */
+
+#include <pthread.h>
+#include "v8api_test_harness.h"
+
+static inline Local<Value> CompileRun(const char* source) {
+  return Script::Compile(String::New(source))->Run();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// Tests
+
+void
+test_IsolateIsSeparate()
+{
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+  CompileRun("var mine = 42;");
+  Isolate* main = Isolate::GetCurrent();
+
+  Isolate* other = Isolate::New();
+  do_check_true(other != main);
+  {
+    Isolate::Scope isolate_scope(other);
+    do_check_true(Isolate::GetCurrent() == other);
+
+    HandleScope other_handle_scope;
+    Persistent<Context> other_context = Context::New();
+    Context::Scope other_context_scope(other_context);
+    do_check_true(CompileRun("typeof mine")->Equals(String::New("undefined")));
+    do_check_eq(CompileRun("6 * 7")->Int32Value(), 42);
+    other_context.Dispose();
+  }
+  do_check_true(Isolate::GetCurrent() == main);
+  other->Dispose();
+
+  // The main isolate is untouched.
+  do_check_eq(CompileRun("mine")->Int32Value(), 42);
+  context.Dispose();
+}
+
+struct ThreadResult {
+  int input;
+  int output;
+};
+
+static void*
+RunInIsolate(void* arg)
+{
+  ThreadResult* result = static_cast<ThreadResult*>(arg);
+  Isolate* isolate = Isolate::New();
+  {
+    Isolate::Scope isolate_scope(isolate);
+    HandleScope handle_scope;
+    TryCatch try_catch;
+    Persistent<Context> context = Context::New();
+    Context::Scope context_scope(context);
+    context->Global()->Set(String::New("input"), Integer::New(result->input));
+    Local<Value> v = CompileRun(
+      "var sum = 0;"
+      "for (var i = 0; i < 100000; i++) { sum = (sum + i * input) % 1000003; }"
+      "sum;"
+    );
+    result->output = v.IsEmpty() ? -1 : v->Int32Value();
+    context.Dispose();
+  }
+  isolate->Dispose();
+  return NULL;
+}
+
+void
+test_IsolatesOnThreads()
+{
+  const int kThreads = 4;
+  pthread_t threads[kThreads];
+  ThreadResult results[kThreads];
+  for (int i = 0; i < kThreads; i++) {
+    results[i].input = i + 1;
+    results[i].output = -1;
+    do_check_eq(pthread_create(&threads[i], NULL, RunInIsolate, &results[i]), 0);
+  }
+  for (int i = 0; i < kThreads; i++) {
+    do_check_eq(pthread_join(threads[i], NULL), 0);
+  }
+
+  // Work out the same thing here to compare.
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+  for (int i = 0; i < kThreads; i++) {
+    context->Global()->Set(String::New("input"), Integer::New(i + 1));
+    Local<Value> expected = CompileRun(
+      "var sum = 0;"
+      "for (var i = 0; i < 100000; i++) { sum = (sum + i * input) % 1000003; }"
+      "sum;"
+    );
+    do_check_eq(results[i].output, expected->Int32Value());
+  }
+  context.Dispose();
+}
+
+void
+test_StructuredCloneBetweenIsolates()
+{
+  StructuredClone clone;
+  {
+    HandleScope handle_scope;
+    Persistent<Context> context = Context::New();
+    Context::Scope context_scope(context);
+    do_check_true(clone.Write(CompileRun("({ a: [1, 'two', { three: 3 }] })")));
+    context.Dispose();
+  }
+
+  Isolate* other = Isolate::New();
+  {
+    Isolate::Scope isolate_scope(other);
+    HandleScope handle_scope;
+    Persistent<Context> context = Context::New();
+    Context::Scope context_scope(context);
+    Local<Value> v = clone.Read();
+    do_check_true(v->IsObject());
+    context->Global()->Set(String::New("v"), v);
+    do_check_true(CompileRun("v.a[0] === 1 && v.a[1] === 'two' && v.a[2].three === 3")->BooleanValue());
+    do_check_true(CompileRun("v.a instanceof Array && Object.getPrototypeOf(v) === Object.prototype")->BooleanValue());
+    context.Dispose();
+  }
+  other->Dispose();
+}
+
+void
+test_StructuredCloneRejectsFunctions()
+{
+  HandleScope handle_scope;
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+  StructuredClone clone;
+  do_check_false(clone.Write(CompileRun("({ f: function() {} })")));
+  context.Dispose();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//// Test Harness
+
+Test gTests[] = {
+  TEST(test_IsolateIsSeparate),
+  TEST(test_IsolatesOnThreads),
+  TEST(test_StructuredCloneBetweenIsolates),
+  TEST(test_StructuredCloneRejectsFunctions),
+};
+
+const char* file = __FILE__;
+#define TEST_NAME "Isolate Class"
+#define TEST_FILE file
+#include "v8api_test_harness_tail.h"
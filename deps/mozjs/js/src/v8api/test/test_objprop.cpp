@@ -190,6 +190,175 @@ test_obj_tmplexn() {
   context.Dispose();
 }
 
+void
+test_obj_hiddengc() {
+  HandleScope handle_scope;
+
+  Persistent<Context> context = Context::New();
+
+  Context::Scope context_scope(context);
+
+  Handle<Object> obj = Object::New();
+  Handle<String> k = String::New("hidden");
+  do_check_true(obj->GetHiddenValue(k).IsEmpty());
+  obj->SetHiddenValue(k, Integer::New(42));
+
+  // Private data of objects that die must not keep anything alive or leave
+  // dangling state behind.
+  {
+    HandleScope inner;
+    for (int i = 0; i < 1000; i++) {
+      Object::New()->SetHiddenValue(k, Object::New());
+    }
+  }
+  JS_GC(i::cx());
+
+  Handle<Value> v = obj->GetHiddenValue(k);
+  do_check_false(v.IsEmpty());
+  do_check_eq(v->Int32Value(), 42);
+  do_check_true(obj->DeleteHiddenValue(k));
+  do_check_true(obj->GetHiddenValue(k)->IsUndefined());
+  context.Dispose();
+}
+
+void
+test_obj_hiddenlookup() {
+  HandleScope handle_scope;
+
+  Persistent<Context> context = Context::New();
+
+  Context::Scope context_scope(context);
+
+  // Reading or deleting hidden values of an object that never had any must
+  // not give it a store.
+  Handle<Object> obj = Object::New();
+  Handle<String> k = String::New("hidden");
+  size_t before = i::GetPrivateDataCount();
+  do_check_true(obj->GetHiddenValue(k).IsEmpty());
+  do_check_false(obj->DeleteHiddenValue(k));
+  do_check_eq(i::GetPrivateDataCount(), before);
+
+  do_check_true(obj->SetHiddenValue(k, Integer::New(1)));
+  do_check_eq(i::GetPrivateDataCount(), before + 1);
+  do_check_true(obj->SetHiddenValue(k, Integer::New(2)));
+  do_check_eq(i::GetPrivateDataCount(), before + 1);
+  do_check_eq(obj->GetHiddenValue(k)->Int32Value(), 2);
+  context.Dispose();
+}
+
+void
+test_obj_keykinds() {
+  HandleScope handle_scope;
+
+  Persistent<Context> context = Context::New();
+
+  Context::Scope context_scope(context);
+
+  // Symbols, plain strings and numbers must all name the same properties.
+  Handle<Object> obj = Object::New();
+  Handle<String> sym = String::NewSymbol("sym");
+  const uint16_t plainChars[] = { 'p', 'l', 0x101, 'i', 'n', 0 };
+  Handle<String> plain = String::New(plainChars);
+  do_check_true(obj->Set(sym, Integer::New(1)));
+  do_check_true(obj->Set(plain, Integer::New(2)));
+  do_check_true(obj->Set(Integer::New(7), Integer::New(3)));
+  do_check_true(obj->Set(Integer::New(-7), Integer::New(4)));
+  do_check_true(obj->Set(Number::New(1.5), Integer::New(5)));
+
+  do_check_eq(obj->Get(String::New("sym"))->Int32Value(), 1);
+  do_check_eq(obj->Get(String::NewSymbol("pl\304\201in"))->Int32Value(), 2);
+  do_check_eq(obj->Get(String::NewSymbol("7"))->Int32Value(), 3);
+  do_check_eq(obj->Get(7)->Int32Value(), 3);
+  do_check_eq(obj->Get(String::New("-7"))->Int32Value(), 4);
+  do_check_eq(obj->Get(String::New("1.5"))->Int32Value(), 5);
+
+  do_check_true(obj->Has(sym));
+  do_check_true(obj->HasRealNamedProperty(plain));
+  do_check_true(obj->Delete(plain));
+  do_check_false(obj->Has(plain));
+  do_check_true(obj->Delete(String::New("7")));
+  do_check_false(obj->Has(7));
+
+  // Attributes still apply through the symbol path.
+  do_check_true(obj->Set(String::NewSymbol("ro"), Integer::New(6), ReadOnly));
+  do_check_true(obj->Set(String::NewSymbol("ro"), Integer::New(7)));
+  do_check_eq(obj->Get(String::New("ro"))->Int32Value(), 6);
+  context.Dispose();
+}
+
+static Local<Value>
+Run(const char *source) {
+  return Script::Compile(String::New(source))->Run();
+}
+
+void
+test_obj_lazyglobal() {
+  HandleScope handle_scope;
+
+  Persistent<Context> context = Context::New();
+
+  Context::Scope context_scope(context);
+
+  // Standard classes resolve on demand but stay hidden from for..in.
+  Handle<Object> global = context->Global();
+  do_check_eq(global->GetPropertyNames()->Length(), 0);
+  do_check_true(Run("typeof Uint8Array == 'function' && Math.max(1, 2) == 2")->BooleanValue());
+  do_check_true(Run("var keys = []; for (var p in this) keys.push(p); keys.join() == 'keys,p'")->BooleanValue());
+  do_check_true(Run("Object.getOwnPropertyNames(this).indexOf('Date') >= 0")->BooleanValue());
+
+  // A prototype from outside the context wins over the builtins it names.
+  Persistent<Context> inner = Context::New();
+  Handle<Object> sandbox = Object::New();
+  sandbox->Set(String::New("escape"), Integer::New(7));
+  {
+    Context::Scope inner_scope(inner);
+    do_check_true(inner->Global()->SetPrototype(sandbox));
+    do_check_eq(Run("escape")->Int32Value(), 7);
+    do_check_true(Run("typeof unescape == 'function'")->BooleanValue());
+  }
+  inner.Dispose();
+  context.Dispose();
+}
+
+void
+test_obj_externalarray() {
+  HandleScope handle_scope;
+
+  Persistent<Context> context = Context::New();
+
+  Context::Scope context_scope(context);
+
+  // Template instances index straight into external data, without copying.
+  uint8_t bytes[4] = { 1, 2, 3, 4 };
+  Handle<Object> obj = ObjectTemplate::New()->NewInstance();
+  obj->SetIndexedPropertiesToExternalArrayData(bytes, kExternalUnsignedByteArray, 4);
+  do_check_true(obj->HasIndexedPropertiesInExternalArrayData());
+  do_check_eq(obj->GetIndexedPropertiesExternalArrayData(), bytes);
+  do_check_eq(obj->GetIndexedPropertiesExternalArrayDataType(), kExternalUnsignedByteArray);
+  do_check_eq(obj->GetIndexedPropertiesExternalArrayDataLength(), 4);
+
+  context->Global()->Set(String::New("arr"), obj);
+  do_check_eq(Run("arr[0] + arr[3]")->Int32Value(), 5);
+  do_check_eq(Run("arr[2] = 258; arr[1] = 7; arr[2]")->Int32Value(), 2);
+  do_check_eq(bytes[1], 7);
+  bytes[1] = 9;
+  do_check_eq(Run("arr[1]")->Int32Value(), 9);
+  do_check_true(Run("arr[4] === undefined")->BooleanValue());
+
+  int32_t ints[2] = { -5, 0 };
+  obj->SetIndexedPropertiesToExternalArrayData(ints, kExternalIntArray, 2);
+  do_check_eq(Run("arr[1] = arr[0] * 2; arr[1]")->Int32Value(), -10);
+  do_check_eq(ints[1], -10);
+
+  // A plain object has nowhere to put the data, and says so.
+  TryCatch trycatch;
+  Handle<Object> plain = Object::New();
+  plain->SetIndexedPropertiesToExternalArrayData(bytes, kExternalUnsignedByteArray, 4);
+  do_check_false(plain->HasIndexedPropertiesInExternalArrayData());
+  do_check_true(trycatch.HasCaught());
+  context.Dispose();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Test Harness
 
@@ -199,6 +368,11 @@ Test gTests[] = {
   TEST(test_obj_defprop),
   TEST(test_obj_propexn),
   TEST(test_obj_tmplexn),
+  TEST(test_obj_hiddengc),
+  TEST(test_obj_hiddenlookup),
+  TEST(test_obj_keykinds),
+  TEST(test_obj_lazyglobal),
+  TEST(test_obj_externalarray),
 };
 
 const char* file = __FILE__;
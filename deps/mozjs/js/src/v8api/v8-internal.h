@@ -26,6 +26,103 @@ public:
 
 void TraceObjectInternals(JSTracer* tracer, void*);
 void DestroyObjectInternals();
+size_t GetPrivateDataCount();
+
+void TraceHandles(JSTracer* tracer);
+void DestroyHandles();
+void DestroyWeakHandleTable(JSCompartment* compartment);
+void DestroyWeakHandleTables();
+size_t GetWeakHandleCount();
+size_t GetWeakCallbacksLastGC();
+
+////////////////////////////////////////////////////////////////////////////////
+//// Isolates
+
+#if defined(_MSC_VER)
+#define V8_THREAD_LOCAL __declspec(thread)
+#else
+#define V8_THREAD_LOCAL __thread
+#endif
+
+struct GCCallbackEntry {
+  GCPrologueCallback callback;
+  GCType filter;
+};
+typedef js::Vector<GCCallbackEntry, 0, js::SystemAllocPolicy> GCCallbackList;
+typedef js::HashMap<JSCompartment*, WeakHandleTable*, js::DefaultHasher<JSCompartment*>, js::SystemAllocPolicy> WeakHandleTableMap;
+
+typedef js::HashSet<void*, js::DefaultHasher<void*>, js::SystemAllocPolicy> HandleChunkSet;
+
+union PersistentSlot;
+struct PersistentSlab;
+class ObjectPrivateDataMap;
+struct ExceptionHandlerChain;
+struct ContextChain;
+
+// Everything the shim knows about one runtime.  Nothing here is shared
+// between isolates, so each can run on its own thread.
+class IsolateState : public Isolate {
+public:
+  IsolateState();
+
+  // Tears down the runtime, leaving the isolate itself.  The isolate must be
+  // the current one.
+  void DestroyRuntime();
+
+  // Runtime (core.cpp)
+  JSRuntime *runtime;
+  JSContext *rootContext;
+  JSObject *compartment;
+  JSCrossCompartmentCall *compartmentCall;
+  bool hasAttemptedInitialization;
+  FatalErrorCallback fatalCallback;
+  jsid prototypeId;
+
+  // Limits, which may be set before the runtime exists
+  uint32_t maxBytes;
+  uint32_t maxMallocBytes;
+  uintptr_t stackLimit;
+  JSGCMode gcMode;
+  // --expose_gc: new contexts get a global gc() function.
+  bool exposeGC;
+
+  // Garbage collection
+  int64_t externalMemory;
+  size_t bytesAfterGC;
+  int64_t externalAfterGC;
+  int64_t gcStart;
+  int64_t lastGCDuration;
+  GCCallbackList gcPrologueCallbacks;
+  GCCallbackList gcEpilogueCallbacks;
+  GCCallbackFlags gcFlags;
+  GCStatistics gcStats;
+
+  // Handles (handles.cpp)
+  HandleScope *handleScope;
+  HandleSlab *firstSlab;
+  HandleSlab *currentSlab;
+  GCReference *top;
+  PersistentSlab *persistentSlabs;
+  PersistentSlot *freePersistents;
+  HandleChunkSet handleChunks;
+  WeakHandleTableMap weakHandleTables;
+  size_t weakCallbacksLastGC;
+
+  // Object private data (object.cpp)
+  ObjectPrivateDataMap *privateDataMap;
+
+  // Scopes (v8.cpp)
+  ExceptionHandlerChain *exnChain;
+  ContextChain *contextChain;
+};
+
+extern V8_THREAD_LOCAL IsolateState *gCurrentIsolate;
+IsolateState *DefaultIsolate();
+
+inline IsolateState *isolate() {
+  IsolateState *current = gCurrentIsolate;
+  return current ? current : DefaultIsolate();
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 //// Tracing and memory management helpers
@@ -95,6 +192,14 @@ private:
 bool IsFunctionTemplate(Handle<Value> v);
 bool IsObjectTemplate(Handle<Value> v);
 
+// Instances of an ObjectTemplate can hold external array data; their class
+// hooks then serve indexed gets and sets from it.  Both return false if obj
+// isn't such an instance, or, for the getter, holds no data.
+bool SetInstanceExternalArrayData(JSObject* obj, void* data,
+                                  ExternalArrayType type, int length);
+bool GetInstanceExternalArrayData(JSObject* obj, void** data,
+                                  ExternalArrayType* type, int* length);
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Accessor Storage
 
@@ -107,6 +212,10 @@ public:
     AccessorSetter setter;
     Traced<Value> data;
     PropertyAttribute attribute;
+    // Trampolines shared by every instance of the owning template, created
+    // on first use.
+    JSObject* sharedGetter;
+    JSObject* sharedSetter;
   };
 private:
   typedef js::HashMap<jsid, PropertyData, JSIDHashPolicy, js::SystemAllocPolicy> AccessorTable;
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <math.h>
 #include "v8-internal.h"
+#include "jscntxt.h"
 #include "jstypedarray.h"
 #include "mozilla/Util.h"
 using namespace mozilla;
@@ -17,7 +18,6 @@ namespace internal {
     ApiExceptionBoundary *boundary;
     ExceptionHandlerChain *next;
   };
-  static ExceptionHandlerChain *gExnChain = 0;
 }
 
 ApiExceptionBoundary::ApiExceptionBoundary()
@@ -25,14 +25,14 @@ ApiExceptionBoundary::ApiExceptionBoundary()
   ExceptionHandlerChain *link = new_<ExceptionHandlerChain>();
   link->catcher = NULL;
   link->boundary = this;
-  link->next = gExnChain;
-  gExnChain = link;
+  link->next = isolate()->exnChain;
+  isolate()->exnChain = link;
 }
 
 ApiExceptionBoundary::~ApiExceptionBoundary() {
-  ExceptionHandlerChain *link = gExnChain;
+  ExceptionHandlerChain *link = isolate()->exnChain;
   JS_ASSERT(link->boundary == this);
-  gExnChain = gExnChain->next;
+  isolate()->exnChain = isolate()->exnChain->next;
   delete_(link);
 }
 
@@ -42,7 +42,7 @@ bool ApiExceptionBoundary::noExceptionOccured() {
 
 
 void TryCatch::ReportError(JSContext *ctx, const char *message, JSErrorReport *report) {
-  if (!gExnChain) {
+  if (!isolate()->exnChain) {
     fprintf(stderr, "%s:%u:%s\n",
             report->filename ? report->filename : "<no filename>",
             (unsigned int) report->lineno,
@@ -57,16 +57,16 @@ void TryCatch::CheckForException() {
 
   // Make sure that we have a TryCatch somewhere on our stack, otherwise we will
   // crash very soon!
-  DebugOnly<bool> TryCatchOnStack = !!gExnChain;
+  DebugOnly<bool> TryCatchOnStack = !!isolate()->exnChain;
   JS_ASSERT(TryCatchOnStack);
 
   // We'll want to pass this exception back to JSAPI to see if it wants to
   // handle it. We'll get another shot again if it didn't.
-  if (gExnChain->boundary) {
+  if (isolate()->exnChain->boundary) {
     return;
   }
 
-  TryCatch *current = gExnChain->catcher;
+  TryCatch *current = isolate()->exnChain->catcher;
 
   Value exn;
   if (!JS_GetPendingException(cx(), &exn.native())) {
@@ -107,14 +107,14 @@ TryCatch::TryCatch() :
   ExceptionHandlerChain *link = new_<ExceptionHandlerChain>();
   link->catcher = this;
   link->boundary = NULL;
-  link->next = gExnChain;
-  gExnChain = link;
+  link->next = isolate()->exnChain;
+  isolate()->exnChain = link;
 }
 
 TryCatch::~TryCatch() {
-  ExceptionHandlerChain *link = gExnChain;
+  ExceptionHandlerChain *link = isolate()->exnChain;
   JS_ASSERT(link->catcher == this);
-  gExnChain = gExnChain->next;
+  isolate()->exnChain = isolate()->exnChain->next;
   delete_(link);
 
   if (mRethrown) {
@@ -181,7 +181,6 @@ namespace internal {
     Context* ctx;
     ContextChain *next;
   };
-  static ContextChain *gContextChain = 0;
 }
 
 Context::Context(JSObject *global) :
@@ -189,13 +188,13 @@ Context::Context(JSObject *global) :
 {}
 
 Local<Context> Context::GetEntered() {
-  return Local<Context>::New(gContextChain->ctx);
+  return Local<Context>::New(isolate()->contextChain->ctx);
 }
 
 Local<Context> Context::GetCurrent() {
   // XXX: This is probably not right
-  if (gContextChain) {
-    return Local<Context>::New(gContextChain->ctx);
+  if (isolate()->contextChain) {
+    return Local<Context>::New(isolate()->contextChain->ctx);
   } else {
     return Local<Context>();
   }
@@ -203,23 +202,31 @@ Local<Context> Context::GetCurrent() {
 
 void Context::Enter() {
   ContextChain *link = new_<ContextChain>();
-  link->next = gContextChain;
+  link->next = isolate()->contextChain;
   link->ctx = this;
   JS_SetGlobalObject(cx(), InternalObject());
-  gContextChain = link;
+  isolate()->contextChain = link;
 }
 
 void Context::Exit() {
   // Sometimes a context scope can hang around after V8::Dispose is called
   if (v8::internal::disposed())
     return;
-  ContextChain *link = gContextChain;
-  gContextChain = gContextChain->next;
+  ContextChain *link = isolate()->contextChain;
+  isolate()->contextChain = isolate()->contextChain->next;
   delete_(link);
-  JSObject *global = gContextChain ? gContextChain->ctx->InternalObject() : NULL;
+  JSObject *global = isolate()->contextChain ? isolate()->contextChain->ctx->InternalObject() : NULL;
   JS_SetGlobalObject(cx(), global);
 }
 
+static JSBool
+ExposedGC(JSContext *cx, uintN argc, jsval *vp)
+{
+  JS_GC(cx);
+  JS_SET_RVAL(cx, vp, JSVAL_VOID);
+  return JS_TRUE;
+}
+
 Persistent<Context> Context::New(
       ExtensionConfiguration* config,
       Handle<ObjectTemplate> global_template,
@@ -227,9 +234,10 @@ Persistent<Context> Context::New(
   if (!global_object.IsEmpty())
     UNIMPLEMENTEDAPI(Persistent<Context>());
   JSObject *global = JS_NewGlobalObject(cx(), &global_class);
-
-  JS_InitStandardClasses(cx(), global);
-  (void)js_InitTypedArrayClasses(cx(), global);
+  if (isolate()->exposeGC &&
+      !JS_DefineFunction(cx(), global, "gc", ExposedGC, 0, 0)) {
+    return Persistent<Context>();
+  }
   if (!global_template.IsEmpty()) {
     JS_SetPrototype(cx(), global, **global_template->NewInstance(global));
   }
@@ -249,12 +257,6 @@ ResourceConstraints::ResourceConstraints() :
 {
 }
 
-bool SetResourceConstraints(ResourceConstraints *constraints) {
-  // TODO: Pull the relevent information out that applies to SM and set some
-  //       globals that would be used.
-  return true;
-}
-
 //////////////////////////////////////////////////////////////////////////////
 //// Value class
 
@@ -682,6 +684,20 @@ ScriptData* ScriptData::New(const char* aData, int aLength) {
   return sd;
 }
 
+ScriptData* ScriptData::New(Handle<v8::Script> script) {
+  ScriptData *sd = new_<ScriptData>();
+  if (!sd)
+    return NULL;
+
+  sd->mScript = **script;
+  sd->mError = !sd->mScript;
+  if (!sd->mScript)
+    return sd;
+
+  JS_AddNamedScriptRoot(cx(), &sd->mScript, "v8::ScriptData::New");
+  return sd;
+}
+
 int ScriptData::Length() {
   if (!mData && mScript)
     SerializeScript(mScript);
@@ -712,7 +728,11 @@ JSScript* ScriptData::GenerateScript(void *aData, int aLen) {
   JS_XDRMemSetData(mXdr, aData, aLen);
 
   JSScript *script;
-  JS_XDRScript(mXdr, &script);
+  if (!JS_XDRScript(mXdr, &script)) {
+    // Stale or foreign data is not an error of the caller's script.
+    JS_ClearPendingException(cx());
+    script = NULL;
+  }
 
   JS_XDRMemSetData(mXdr, NULL, 0);
   JS_SetErrorReporter(cx(), older);
@@ -829,6 +849,36 @@ Local<Value> Script::Id() {
   return Local<Value>::New(&v);
 }
 
+//////////////////////////////////////////////////////////////////////////////
+//// StructuredClone class
+
+bool StructuredClone::Write(Handle<Value> value) {
+  mBuffer.clear();
+  if (mBuffer.write(cx(), value->native())) {
+    return true;
+  }
+  TryCatch::CheckForException();
+  return false;
+}
+
+Local<Value> StructuredClone::Read() const {
+  // With no script running, new objects would get their prototypes from the
+  // root compartment's global rather than the entered context's.
+  JSContext *ctx = cx();
+  JSObject *global = JS_GetGlobalObject(ctx);
+  js::DummyFrameGuard frame;
+  if (global && !ctx->stack.pushDummyFrame(ctx, ctx->compartment, *global, &frame)) {
+    return Local<Value>();
+  }
+
+  Value v;
+  if (mBuffer.read(ctx, &v.native())) {
+    return Local<Value>::New(&v);
+  }
+  TryCatch::CheckForException();
+  return Local<Value>();
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //// Message class
 
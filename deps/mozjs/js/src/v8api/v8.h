@@ -23,12 +23,15 @@ class Context;
 class Message;
 class StackTrace;
 class Function;
+class Script;
 class ScriptOrigin;
 class AccessorInfo;
 class FunctionTemplate;
 class ObjectTemplate;
 class Signature;
 class HeapStatistics;
+class CompartmentHeapStatistics;
+class GCStatistics;
 template <class T> class Handle;
 template <class T> class Local;
 template <class T> class Persistent;
@@ -48,14 +51,14 @@ typedef void (*WeakReferenceCallback)(Persistent<Value> object,
 
 namespace internal {
 class GCReference;
-struct GCOps;
-class GCReferenceContainer;
+struct HandleSlab;
+class IsolateState;
 struct PersistentGCReference;
+class WeakHandleTable;
 
 void notImplemented(const char* functionName);
 
 class GCReference {
-  friend struct GCOps;
   friend struct PersistentGCReference;
   
   void root(JSContext *ctx) {
@@ -87,7 +90,7 @@ struct PersistentGCReference : public GCReference {
   ~PersistentGCReference();
 
   bool IsWeak() const {
-    return prev != NULL || next != NULL;
+    return weakIndex != kNotWeak;
   }
   bool IsNearDeath() const {
     return isNearDeath;
@@ -99,12 +102,14 @@ private:
   WeakReferenceCallback callback;
   void *context;
   bool isNearDeath;
-  PersistentGCReference *prev, *next;
+  // Slot in the weak handle table, or kNotWeak.
+  size_t weakIndex;
 
-  static PersistentGCReference *weakPtrs;
+  static const size_t kNotWeak = size_t(-1);
   static void CheckForWeakHandles();
 
   friend class v8::V8;
+  friend class WeakHandleTable;
 };
 
 template <class Inherits>
@@ -150,15 +155,17 @@ struct HandleScope {
 private:
   friend class V8;
   friend class internal::GCReference;
+  friend class internal::IsolateState;
   static internal::GCReference *CreateHandle(internal::GCReference r);
   static bool IsLocalReference(internal::GCReference *);
 
-  static HandleScope *sCurrent;
   size_t getHandleCount();
   internal::GCReference* InternalClose(internal::GCReference*);
   void Destroy();
 
-  internal::GCReferenceContainer *mGCReferences;
+  // The handle arena's slab and top pointer when this scope was opened.
+  internal::HandleSlab *mSlab;
+  internal::GCReference *mTop;
   HandleScope *mPrevious;
 };
 
@@ -343,6 +350,7 @@ enum GCCallbackFlags {
 };
 
 typedef void (*GCPrologueCallback)(GCType type, GCCallbackFlags flags);
+typedef void (*GCEpilogueCallback)(GCType type, GCCallbackFlags flags);
 
 
 // Exceptions
@@ -360,18 +368,78 @@ typedef void (*FatalErrorCallback)(const char* location, const char* message);
 Handle<Value> ThrowException(Handle<Value> exception);
 
 
+// Each isolate is a separate runtime with its own heap, handles and
+// contexts.  A thread uses the isolate it has entered; one that never enters
+// any uses the default isolate, so single threaded embedders need not care.
+// An isolate may only be used by one thread at a time.
+class Isolate {
+public:
+  class Scope {
+  public:
+    explicit Scope(Isolate* isolate) : mIsolate(isolate) {
+      mIsolate->Enter();
+    }
+    ~Scope() {
+      mIsolate->Exit();
+    }
+  private:
+    Isolate* const mIsolate;
+
+    Scope(const Scope&);
+    Scope& operator=(const Scope&);
+  };
+
+  static Isolate* New();
+  static Isolate* GetCurrent();
+  // Tears down the runtime.  The isolate must not be entered.
+  void Dispose();
+  void Enter();
+  void Exit();
+
+  void SetData(void* data) {
+    mData = data;
+  }
+  void* GetData() {
+    return mData;
+  }
+protected:
+  Isolate();
+  ~Isolate() {}
+private:
+  Isolate* mPrevious;
+  int mEntryCount;
+  void* mData;
+
+  Isolate(const Isolate&);
+  Isolate& operator=(const Isolate&);
+};
+
 class V8 {
 public:
   static bool Initialize();
   static bool Dispose();
 
-  static bool IdleNotification();
+  // Does a slice of garbage collection work that fits in hint milliseconds
+  // of idle time.  Returns true once there is nothing more worth doing.
+  static bool IdleNotification(int hint = 1000);
   static void GetHeapStatistics(HeapStatistics* aHeapStatistics);
+  // Not in V8: points aStats at a new array with one entry per compartment
+  // and returns its length.  The caller delete[]s the array.  This walks
+  // the whole heap once.
+  static size_t GetCompartmentHeapStatistics(CompartmentHeapStatistics** aStats);
   static const char* GetVersion();
   static void SetFlagsFromCommandLine(int* argc, char** argv, bool aRemoveFlags);
   static void SetFatalErrorHandler(FatalErrorCallback aCallback);
   static int AdjustAmountOfExternalAllocatedMemory(int aChangeInBytes);
+  // Every SpiderMonkey collection is a full mark and sweep, so callbacks
+  // only ever see kGCTypeMarkSweepCompact.  They run inside the collection
+  // and must not touch the JS heap.
   static void AddGCPrologueCallback(GCPrologueCallback aCallback, GCType aGCTypeFilter = kGCTypeAll);
+  static void RemoveGCPrologueCallback(GCPrologueCallback aCallback);
+  static void AddGCEpilogueCallback(GCEpilogueCallback aCallback, GCType aGCTypeFilter = kGCTypeAll);
+  static void RemoveGCEpilogueCallback(GCEpilogueCallback aCallback);
+  // Not in V8: pause times of every collection so far.
+  static void GetGCStatistics(GCStatistics* aStats);
   static void LowMemoryNotification();
 private:
   static JSBool GCCallback(JSContext*, JSGCStatus);
@@ -384,6 +452,7 @@ class TryCatch {
   friend class Value;
   friend class Object;
   friend class Function;
+  friend class StructuredClone;
   static void ReportError(JSContext *ctx, const char *message, JSErrorReport *report);
   static void CheckForException();
 
@@ -479,10 +548,12 @@ bool SetResourceConstraints(ResourceConstraints *constraints);
 class HeapStatistics {
  public:
   HeapStatistics();
-  size_t total_heap_size() { UNIMPLEMENTEDAPI(total_heap_size_); }
-  size_t total_heap_size_executable() { UNIMPLEMENTEDAPI(total_heap_size_executable_); }
+  size_t total_heap_size() { return total_heap_size_; }
+  size_t total_heap_size_executable() { return total_heap_size_executable_; }
   size_t used_heap_size() { return used_heap_size_; }
   size_t heap_size_limit() { return heap_size_limit_; }
+  size_t number_of_weak_handles() { return number_of_weak_handles_; }
+  size_t weak_callbacks_last_gc() { return weak_callbacks_last_gc_; }
  private:
   void set_total_heap_size(size_t size) { total_heap_size_ = size; }
   void set_total_heap_size_executable(size_t size) {
@@ -490,11 +561,87 @@ class HeapStatistics {
   }
   void set_used_heap_size(size_t size) { used_heap_size_ = size; }
   void set_heap_size_limit(size_t size) { heap_size_limit_ = size; }
+  void set_number_of_weak_handles(size_t count) {
+    number_of_weak_handles_ = count;
+  }
+  void set_weak_callbacks_last_gc(size_t count) {
+    weak_callbacks_last_gc_ = count;
+  }
 
   size_t total_heap_size_;
   size_t total_heap_size_executable_;
   size_t used_heap_size_;
   size_t heap_size_limit_;
+  size_t number_of_weak_handles_;
+  size_t weak_callbacks_last_gc_;
+
+  friend class V8;
+};
+
+// Not in V8: what the memory of one compartment is made of.  Each size
+// covers the GC things of that kind and whatever they own outside the GC
+// heap; unused_size is what the compartment's arenas hold but don't use.
+class CompartmentHeapStatistics {
+ public:
+  CompartmentHeapStatistics();
+  const char* name() { return name_; }
+  size_t objects_size() { return objects_size_; }
+  size_t strings_size() { return strings_size_; }
+  size_t shapes_size() { return shapes_size_; }
+  size_t scripts_size() { return scripts_size_; }
+  size_t type_inference_size() { return type_inference_size_; }
+  size_t mjit_code_size() { return mjit_code_size_; }
+  size_t unused_size() { return unused_size_; }
+ private:
+  char name_[32];
+  size_t objects_size_;
+  size_t strings_size_;
+  size_t shapes_size_;
+  size_t scripts_size_;
+  size_t type_inference_size_;
+  size_t mjit_code_size_;
+  size_t unused_size_;
+
+  friend class V8;
+};
+
+// Not in V8: how long collections have paused the process, in
+// microseconds.  Pause times cover the whole collection; the phase times
+// are the parts of it the engine tracks, and only mark and sweep are
+// disjoint.  histogram(i) counts the pauses shorter than 2^i ms, less
+// those counted in earlier buckets; the last bucket has the rest.
+enum GCPhase {
+  kGCPhaseMark,
+  kGCPhaseSweep,
+  kGCPhaseSweepObjects,
+  kGCPhaseSweepStrings,
+  kGCPhaseSweepScripts,
+  kGCPhaseSweepShapes,
+  kGCPhaseDiscardCode,
+  kGCPhaseDestroy,
+  kGCPhaseCount
+};
+
+class GCStatistics {
+ public:
+  static const int kHistogramBuckets = 12;
+
+  GCStatistics();
+  size_t count() { return count_; }
+  uint64_t total_pause() { return total_pause_; }
+  uint64_t max_pause() { return max_pause_; }
+  uint64_t last_pause() { return last_pause_; }
+  uint64_t phase_time(GCPhase aPhase) { return phase_times_[aPhase]; }
+  uint64_t last_phase_time(GCPhase aPhase) { return last_phase_times_[aPhase]; }
+  size_t histogram(int aBucket) { return histogram_[aBucket]; }
+ private:
+  size_t count_;
+  uint64_t total_pause_;
+  uint64_t max_pause_;
+  uint64_t last_pause_;
+  uint64_t phase_times_[kGCPhaseCount];
+  uint64_t last_phase_times_[kGCPhaseCount];
+  size_t histogram_[kHistogramBuckets];
 
   friend class V8;
 };
@@ -650,6 +797,8 @@ class String : public Primitive  {
   String(JSString *s) : Primitive (STRING_TO_JSVAL(s)) { }
 
   operator JSString*() const { return JSVAL_TO_STRING(mVal); }
+
+  static void FinalizeExternal(const JSStringFinalizer* fin, jschar* chars);
 public:
   int Length() const;
   int Utf8Length() const;
@@ -698,6 +847,20 @@ public:
     int length() const { return mLength; }
   };
 
+  class Value {
+    uint16_t* mStr;
+    int mLength;
+    // Disallow copying and assigning.
+    Value(const Value&);
+    void operator=(const Value&);
+  public:
+    explicit Value(Handle<v8::Value> val);
+    ~Value();
+    uint16_t* operator*() { return mStr; }
+    const uint16_t* operator*() const { return mStr; }
+    int length() const { return mLength; }
+  };
+
   class ExternalStringResourceBase {
   public:
     virtual ~ExternalStringResourceBase() {}
@@ -712,6 +875,9 @@ public:
     virtual ~ExternalStringResource() {}
     virtual const uint16_t* data() const = 0;
     virtual size_t length() const = 0;
+    // Not in V8: a resource returns true to promise that data()[length()]
+    // is a NUL, which SpiderMonkey needs to use the characters in place.
+    virtual bool IsTerminated() const { return false; }
   protected:
     ExternalStringResource() {}
   };
@@ -725,9 +891,9 @@ public:
     ExternalAsciiStringResource() {}
   };
 
-  static Local<String> NewExternal(ExternalStringResource* resource) {
-    UNIMPLEMENTEDAPI(Local<String>());
-  }
+  // Resources that do not promise a terminating NUL through IsTerminated()
+  // are copied and disposed of right away.
+  static Local<String> NewExternal(ExternalStringResource* resource);
   bool MakeExternal(ExternalStringResource* resource) {
     UNIMPLEMENTEDAPI(false);
   }
@@ -738,13 +904,14 @@ public:
   bool CanMakeExternal() {
     UNIMPLEMENTEDAPI(false);
   }
+  bool IsExternal() const;
 
   static Local<String> New(const char *data, int length = -1);
   static Local<String> New(const uint16_t* data, int length = -1);
   static Local<String> NewSymbol(const char* data, int length = -1);
   static Local<String> Concat(Handle<String> left, Handle<String> right);
   static Local<String> FromJSID(jsid id);
-  static inline String* Cast(Value *v) {
+  static inline String* Cast(v8::Value *v) {
     if (v->IsString())
       return reinterpret_cast<String*>(v);
     return NULL;
@@ -771,7 +938,9 @@ enum ExternalArrayType {
   kExternalUnsignedShortArray,
   kExternalIntArray,
   kExternalUnsignedIntArray,
-  kExternalFloatArray
+  kExternalFloatArray,
+  kExternalDoubleArray,
+  kExternalPixelArray
 };
 
 typedef Handle<Value> (*AccessorGetter)(Local<String> property, const AccessorInfo &info);
@@ -788,7 +957,10 @@ class Object : public Value {
 public:
   struct PrivateData;
 private:
-  PrivateData& GetHiddenStore();
+  // Returns NULL if the object has no hidden store yet.
+  PrivateData* GetHiddenStore();
+  // Returns NULL when out of memory.
+  PrivateData* CreateHiddenStore();
   friend class Context;
   friend class Script;
   friend class Template;
@@ -802,6 +974,13 @@ private:
 
   static JSBool JSAPIPropertyGetter(JSContext* cx, uintN argc, jsval* vp);
   static JSBool JSAPIPropertySetter(JSContext* cx, uintN argc, jsval* vp);
+  // Creates the getter/setter trampolines SetAccessor installs.  A pair made
+  // without an owner is shared by every object of holderClass and finds its
+  // holder on the receiver's prototype chain.
+  static bool NewAccessorPair(Handle<String> name, AccessorGetter getter,
+                              AccessorSetter setter, Handle<Value> data,
+                              JSObject* owner, JSClass* holderClass,
+                              JSObject** getterObj, JSObject** setterObj);
 protected:
   Object(JSObject *obj);
 public:
@@ -928,7 +1107,7 @@ public:
 
 class ScriptData {
 public:
-  ScriptData() : mXdr(NULL), mData(NULL), mLen(0), mError(true) {}
+  ScriptData() : mXdr(NULL), mData(NULL), mLen(0), mError(true), mScript(NULL) {}
 
 protected:
   void SerializeScript(JSScript *script);
@@ -944,6 +1123,9 @@ public:
   static ScriptData* PreCompile(const char* input, int length);
   static ScriptData* PreCompile(Handle<String> source);
   static ScriptData* New(const char* data, int length);
+  // Not in V8: wraps an already compiled script, so that Data() is its
+  // serialized form and can be handed back to New() in a later process.
+  static ScriptData* New(Handle<v8::Script> script);
   int Length();
   const char* Data();
   bool HasError();
@@ -961,6 +1143,7 @@ class Script : public v8::Object {
   }
   
   static Local<Script> Create(Handle<String> source, ScriptOrigin *origin, ScriptData *preData, Handle<String> scriptData, bool bindToCurrentContext);
+  friend class ScriptData;
 public:
   static Local<Script> New(Handle<String> source, ScriptOrigin *origin = NULL,
                            ScriptData *preData = NULL,
@@ -976,6 +1159,24 @@ public:
   Local<Value> Id();
 };
 
+// Not in V8: a structured clone of a value, as postMessage makes.  The
+// serialized form belongs to no isolate, so it can be written in one and
+// read back in another.
+class StructuredClone {
+public:
+  StructuredClone() {}
+
+  // Returns false if the value holds something that cannot be cloned, such
+  // as a function.
+  bool Write(Handle<Value> value);
+  Local<Value> Read() const;
+private:
+  JSAutoStructuredCloneBuffer mBuffer;
+
+  StructuredClone(const StructuredClone&);
+  StructuredClone& operator=(const StructuredClone&);
+};
+
 class Template : public internal::SecretObject<Data> {
 public:
   void Set(Handle<String> name, Handle<Data> value,
@@ -1084,6 +1285,7 @@ class ObjectTemplate : public Template {
 
   void SetPrototype(Handle<ObjectTemplate> o);
   void SetObjectName(Handle<String> s);
+  Local<Object> NewInstance(JSObject* parent, JSObject* proto);
   friend class FunctionTemplate;
 public:
   static Local<ObjectTemplate> New();
@@ -19,7 +19,9 @@
 // OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
 // USE OR OTHER DEALINGS IN THE SOFTWARE.
 
-var SlowBuffer = process.binding('buffer').SlowBuffer;
+var binding = process.binding('buffer');
+var SlowBuffer = binding.SlowBuffer;
+var setRawArray = binding.setRawArray;
 
 
 function toHex(n) {
@@ -463,6 +465,7 @@ function createParentProxy(proxy, handler) {
 function proxifyArray(array) {
   // Other classes like to stash properties on us
   var propHolder = Object.create(Buffer.prototype);
+  var parent;
   var handler = {
     // Fundamental traps
     getOwnPropertyDescriptor: function(name) {
@@ -507,7 +510,11 @@ function proxifyArray(array) {
         return array;
       }
       if (name == 'parent') {
-        return createParentProxy(this, handler);
+        if (!parent) {
+          parent = createParentProxy(this, handler);
+          setRawArray(parent, array);
+        }
+        return parent;
       }
       if (isNaN(+name) && name in propHolder) {
         return propHolder[name];
@@ -531,7 +538,12 @@ function proxifyArray(array) {
     },
     keys: function() { return Object.keys(array) }
   };
-  return Proxy.create(handler);
+
+  // The native methods find the array through a slot on the proxy rather
+  // than through the get trap.
+  var proxy = Proxy.create(handler);
+  setRawArray(proxy, array);
+  return proxy;
 }
 
 function createTypedArray(subject, encoding, offset) {
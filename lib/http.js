@@ -24,7 +24,11 @@ var net = require('net');
 var stream = require('stream');
 var EventEmitter = require('events').EventEmitter;
 var FreeList = require('freelist').FreeList;
-var HTTPParser = process.binding('http_parser').HTTPParser;
+var binding = process.binding('http_parser');
+var HTTPParser = binding.HTTPParser;
+var HEADER_FIRST = binding.HEADER_FIRST;
+var HEADER_JOIN = binding.HEADER_JOIN;
+var HEADER_ARRAY = binding.HEADER_ARRAY;
 var assert = require('assert').ok;
 
 
@@ -41,50 +45,25 @@ var parsers = new FreeList('parsers', 1000, function() {
 
   parser.onMessageBegin = function() {
     parser.incoming = new IncomingMessage(parser.socket);
-    parser.field = null;
-    parser.value = null;
+    parser._headers = [];
+    parser._url = '';
   };
 
-  // Only servers will get URL events.
-  parser.onURL = function(b, start, len) {
-    var slice = b.toString('ascii', start, start + len);
-    if (parser.incoming.url) {
-      parser.incoming.url += slice;
-    } else {
-      // Almost always will branch here.
-      parser.incoming.url = slice;
-    }
-  };
-
-  parser.onHeaderField = function(b, start, len) {
-    var slice = b.toString('ascii', start, start + len).toLowerCase();
-    if (parser.value != undefined) {
-      parser.incoming._addHeaderLine(parser.field, parser.value);
-      parser.field = null;
-      parser.value = null;
-    }
-    if (parser.field) {
-      parser.field += slice;
-    } else {
-      parser.field = slice;
-    }
-  };
-
-  parser.onHeaderValue = function(b, start, len) {
-    var slice = b.toString('ascii', start, start + len);
-    if (parser.value) {
-      parser.value += slice;
-    } else {
-      parser.value = slice;
-    }
+  // The binding collects the URL and headers itself and passes them to
+  // onHeadersComplete.  This is only called when a message has more headers
+  // than it keeps at once, and for trailers.
+  parser.onHeaders = function(headers, url) {
+    parser._headers = parser._headers.concat(headers);
+    parser._url += url;
   };
 
   parser.onHeadersComplete = function(info) {
-    if (parser.field && (parser.value != undefined)) {
-      parser.incoming._addHeaderLine(parser.field, parser.value);
-      parser.field = null;
-      parser.value = null;
+    var headers = info.headers;
+    if (parser._headers.length) {
+      headers = parser._headers.concat(headers);
+      parser._headers = [];
     }
+    parser.incoming._addHeaderLines(headers);
 
     parser.incoming.httpVersionMajor = info.versionMajor;
     parser.incoming.httpVersionMinor = info.versionMinor;
@@ -93,6 +72,8 @@ var parsers = new FreeList('parsers', 1000, function() {
     if (info.method) {
       // server only
       parser.incoming.method = info.method;
+      parser.incoming.url = parser._url + info.url;
+      parser._url = '';
     } else {
       // client only
       parser.incoming.statusCode = info.statusCode;
@@ -124,8 +105,9 @@ var parsers = new FreeList('parsers', 1000, function() {
 
   parser.onMessageComplete = function() {
     this.incoming.complete = true;
-    if (parser.field && (parser.value != undefined)) {
-      parser.incoming._addHeaderLine(parser.field, parser.value);
+    if (parser._headers.length) {
+      parser.incoming._addHeaderLines(parser._headers);
+      parser._headers = [];
     }
     if (!parser.incoming.upgrade) {
       // For upgraded connections, also emit this after parser.execute
@@ -255,6 +237,16 @@ IncomingMessage.prototype.resume = function() {
 };
 
 
+// headers is [field, value, policy, ...], as the parser hands them over.
+// Field names are already lowercase.
+IncomingMessage.prototype._addHeaderLines = function(headers) {
+  var dest = this.complete ? this.trailers : this.headers;
+  for (var i = 0, n = headers.length; i < n; i += 3) {
+    addHeader(dest, headers[i], headers[i + 1], headers[i + 2]);
+  }
+};
+
+
 // Add the given (field, value) pair to the message
 //
 // Per RFC2616, section 4.2 it is acceptable to join multiple instances of the
@@ -264,16 +256,17 @@ IncomingMessage.prototype.resume = function() {
 // always joined.
 IncomingMessage.prototype._addHeaderLine = function(field, value) {
   var dest = this.complete ? this.trailers : this.headers;
+  addHeader(dest, field, value, headerPolicy(field));
+};
 
+
+// The parser works this out itself for the messages it reads; see
+// tools/gen_http_headers.py.
+function headerPolicy(field) {
   switch (field) {
     // Array headers:
     case 'set-cookie':
-      if (field in dest) {
-        dest[field].push(value);
-      } else {
-        dest[field] = [value];
-      }
-      break;
+      return HEADER_ARRAY;
 
     // Comma separate. Maybe make these arrays?
     case 'accept':
@@ -283,29 +276,24 @@ IncomingMessage.prototype._addHeaderLine = function(field, value) {
     case 'connection':
     case 'cookie':
     case 'pragma':
-      if (field in dest) {
-        dest[field] += ', ' + value;
-      } else {
-        dest[field] = value;
-      }
-      break;
-
+      return HEADER_JOIN;
 
     default:
-      if (field.slice(0, 2) == 'x-') {
-        // except for x-
-        if (field in dest) {
-          dest[field] += ', ' + value;
-        } else {
-          dest[field] = value;
-        }
-      } else {
-        // drop duplicates
-        if (!(field in dest)) dest[field] = value;
-      }
-      break;
+      return field.slice(0, 2) == 'x-' ? HEADER_JOIN : HEADER_FIRST;
   }
-};
+}
+
+
+function addHeader(dest, field, value, policy) {
+  if (!(field in dest)) {
+    dest[field] = policy == HEADER_ARRAY ? [value] : value;
+  } else if (policy == HEADER_ARRAY) {
+    dest[field].push(value);
+  } else if (policy == HEADER_JOIN) {
+    dest[field] += ', ' + value;
+  }
+  // HEADER_FIRST drops duplicates.
+}
 
 
 function OutgoingMessage() {
@@ -375,6 +363,9 @@ OutgoingMessage.prototype._writeRaw = function(data, encoding) {
   if (this.connection &&
       this.connection._httpMessage === this &&
       this.connection.writable) {
+    // Everything written in this tick goes to the socket together.
+    if (this.connection._cork) this.connection._cork();
+
     // There might be pending data in the this.output buffer.
     while (this.output.length) {
       if (!this.connection.writable) {
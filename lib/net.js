@@ -26,6 +26,8 @@ var timers = require('timers');
 
 var kMinPoolSpace = 128;
 var kPoolSize = 40 * 1024;
+var kAcceptBatch = 64;
+var kHighWaterMark = 16 * 1024;
 
 var debug;
 if (process.env.NODE_DEBUG && /net/.test(process.env.NODE_DEBUG)) {
@@ -56,13 +58,18 @@ var bind = binding.bind;
 var connect = binding.connect;
 var listen = binding.listen;
 var accept = binding.accept;
+var acceptMany = binding.acceptMany;
+var peerAddress = binding.peerAddress;
+var kPeerStride = binding.peerStride;
 var close = binding.close;
 var shutdown = binding.shutdown;
 var read = binding.read;
 var write = binding.write;
+var writev = binding.writev;
 var toRead = binding.toRead;
 var setNoDelay = binding.setNoDelay;
 var setKeepAlive = binding.setKeepAlive;
+var setReusePort = binding.setReusePort;
 var socketError = binding.socketError;
 var getsockname = binding.getsockname;
 var errnoException = binding.errnoException;
@@ -268,6 +275,25 @@ exports.createConnection = function(port, host) {
 };
 
 
+// Connections from _acceptMany keep the peer's address raw until it's
+// asked for.
+Object.defineProperty(Socket.prototype, 'remoteAddress', {
+  get: function() {
+    var peer = this._peer;
+    if (peer) {
+      this._peer = null;
+      this._remoteAddress = peerAddress(peer[0], peer[1], peer[2],
+                                        peer[3], peer[4]);
+    }
+    return this._remoteAddress;
+  },
+  set: function(address) {
+    this._peer = null;
+    this._remoteAddress = address;
+  }
+});
+
+
 Object.defineProperty(Socket.prototype, 'readyState', {
   get: function() {
     if (this._connecting) {
@@ -291,7 +317,8 @@ Object.defineProperty(Socket.prototype, 'readyState', {
 
 // Returns true if all the data was flushed to socket. Returns false if
 // something was queued. If data was queued, then the 'drain' event will
-// signal when it has been finally flushed to socket.
+// signal when it has been finally flushed to socket. Writes held back by
+// _cork() return false only once kHighWaterMark bytes are waiting.
 Socket.prototype.write = function(data /* [encoding], [fd], [cb] */) {
   var encoding, fd, cb;
 
@@ -321,7 +348,8 @@ Socket.prototype.write = function(data /* [encoding], [fd], [cb] */) {
 
   // TODO - actually use cb
 
-  if (this._connecting || (this._writeQueue && this._writeQueue.length)) {
+  if (this._connecting || this._corked ||
+      (this._writeQueue && this._writeQueue.length)) {
     if (!this._writeQueue) {
       this.bufferSize = 0;
       this._writeQueue = [];
@@ -370,12 +398,17 @@ Socket.prototype.write = function(data /* [encoding], [fd], [cb] */) {
     this._onBufferChange();
     DTRACE_NET_SOCKET_WRITE(this, 0);
 
-    return false;
+    var ret = this._corked && !this._connecting &&
+              this._writeQueueSize() < kHighWaterMark;
+    if (!ret) this._needDrain = true;
+    return ret;
   } else {
     // Fast.
     // The most common case. There is no write queue. Just push the data
     // directly to the socket.
-    return this._writeOut(data, encoding, fd, cb);
+    var ret = this._writeOut(data, encoding, fd, cb);
+    if (!ret) this._needDrain = true;
+    return ret;
   }
 };
 
@@ -503,6 +536,106 @@ Socket.prototype._writeOut = function(data, encoding, fd, cb) {
 };
 
 
+// Like _writeOut, but for several chunks at once, which go to the socket
+// in a single writev(2). Strings are encoded into the pool first. Whatever
+// doesn't make it is put back at the front of _writeQueue.
+Socket.prototype._writevOut = function(data, encodings, cbs) {
+  if (!this.writable) {
+    throw new Error('Socket is not writable');
+  }
+
+  var buffers = [], offsets = [], lengths = [];
+  var total = 0;
+
+  for (var i = 0; i < data.length; i++) {
+    var chunk = data[i];
+    var len;
+
+    if (typeof chunk != 'string') {
+      buffers.push(chunk);
+      offsets.push(0);
+      len = chunk.length;
+    } else {
+      var encoding = encodings[i] || 'utf8';
+      len = Buffer.byteLength(chunk, encoding);
+
+      if (len > kPoolSize - kMinPoolSpace) {
+        buffers.push(new Buffer(chunk, encoding));
+        offsets.push(0);
+      } else {
+        if (!pool || pool.length - pool.used < len) {
+          pool = null;
+          allocNewPool();
+        }
+        pool.write(chunk, encoding, pool.used);
+        buffers.push(pool);
+        offsets.push(pool.used);
+        pool.used += len;
+      }
+    }
+
+    lengths.push(len);
+    total += len;
+  }
+
+  var bytesWritten;
+  try {
+    bytesWritten = writev(this.fd, buffers, offsets, lengths);
+    DTRACE_NET_SOCKET_WRITE(this, bytesWritten);
+  } catch (e) {
+    this.destroy(e);
+    return false;
+  }
+
+  debug('wrote ' + bytesWritten + ' of ' + total + ' bytes to socket ' +
+        'in ' + buffers.length + ' chunks.');
+
+  timers.active(this);
+
+  var left = bytesWritten;
+  for (i = 0; i < buffers.length && left >= lengths[i]; i++) {
+    left -= lengths[i];
+    if (cbs[i]) cbs[i]();
+  }
+
+  if (i == buffers.length) return true;
+
+  // Need to wait for the socket to become available before trying again.
+  this._writeWatcher.start();
+
+  for (var j = buffers.length - 1; j >= i; j--) {
+    var start = offsets[j] + (j == i ? left : 0);
+    var leftOver = buffers[j].slice(start, offsets[j] + lengths[j]);
+    leftOver.used = leftOver.length;
+
+    this.bufferSize += leftOver.length;
+    this._writeQueue.unshift(leftOver);
+    this._writeQueueEncoding.unshift(null);
+    this._writeQueueCallbacks.unshift(cbs[j]);
+  }
+  this._onBufferChange();
+
+  return false;
+};
+
+
+// Holds writes back in _writeQueue until the next tick, so that everything
+// written in this one reaches the socket in a single writev(2).
+Socket.prototype._cork = function() {
+  if (this._corked) return;
+  this._corked = true;
+
+  var self = this;
+  process.nextTick(function() {
+    self._corked = false;
+    if (self.writable && !self._connecting &&
+        self._writeQueue && self._writeQueue.length) {
+      self._onWritable();
+    }
+  });
+};
+
+
 Socket.prototype._onBufferChange = function() {
   // Put DTrace hooks here.
   ;
@@ -513,6 +646,21 @@ Socket.prototype._onBufferChange = function() {
 // Returns true if the entire buffer was flushed.
 Socket.prototype.flush = function() {
   while (this._writeQueue && this._writeQueue.length) {
+    var count = this._writevCount();
+    if (count > 1) {
+      var chunks = this._writeQueue.splice(0, count);
+      var encodings = this._writeQueueEncoding.splice(0, count);
+      var cbs = this._writeQueueCallbacks.splice(0, count);
+
+      for (var i = 0; i < count; i++) {
+        this.bufferSize -= chunks[i].length;
+      }
+      this._onBufferChange();
+
+      if (!this._writevOut(chunks, encodings, cbs)) return false;
+      continue;
+    }
+
     var data = this._writeQueue.shift();
     var encoding = this._writeQueueEncoding.shift();
     var cb = this._writeQueueCallbacks.shift();
@@ -535,6 +683,36 @@ Socket.prototype.flush = function() {
 };
 
 
+// How many chunks at the head of _writeQueue can go out in one writev(2).
+// File descriptors have to be sent one at a time with sendmsg(2).
+Socket.prototype._writevCount = function() {
+  if (!writev || this._writeQueueFD.length) return 0;
+
+  var count = 0;
+  while (count < this._writeQueue.length &&
+         this._writeQueue[count] !== END_OF_FILE) {
+    count++;
+  }
+  return count;
+};
+
+
+// Bytes waiting in _writeQueue, counting strings in their encoding.
+Socket.prototype._writeQueueSize = function() {
+  var size = 0;
+  for (var i = 0; i < this._writeQueue.length; i++) {
+    var data = this._writeQueue[i];
+    if (data === END_OF_FILE) break;
+    if (typeof data == 'string') {
+      size += Buffer.byteLength(data, this._writeQueueEncoding[i]);
+    } else {
+      size += data.length;
+    }
+  }
+  return size;
+};
+
+
 Socket.prototype._writeQueueLast = function() {
   return this._writeQueue.length > 0 ?
       this._writeQueue[this._writeQueue.length - 1] : null;
@@ -608,8 +786,12 @@ Socket.prototype._onWritable = function() {
   // Socket becomes writable on connect() but don't flush if there's
   // nothing actually to write
   if (this.flush()) {
-    if (this._events && this._events['drain']) this.emit('drain');
-    if (this.ondrain) this.ondrain(); // Optimization
+    // Only writers that were told to back off are waiting for 'drain'.
+    if (this._needDrain) {
+      this._needDrain = false;
+      if (this._events && this._events['drain']) this.emit('drain');
+      if (this.ondrain) this.ondrain(); // Optimization
+    }
     if (this.__destroyOnDrain) this.destroy();
   }
 };
@@ -890,6 +1072,7 @@ function Server(/* [ options, ] listener */) {
   self.connections = 0;
 
   self.allowHalfOpen = options.allowHalfOpen || false;
+  self.reusePort = options.reusePort || false;
 
   self.watcher = new IOWatcher();
   self.watcher.host = self;
@@ -903,6 +1086,11 @@ function Server(/* [ options, ] listener */) {
       self.watcher.stop();
     }
 
+    if (acceptMany && self.type != 'unix') {
+      self._acceptMany();
+      return;
+    }
+
     while (typeof self.fd === 'number') {
       try {
         var peerInfo = accept(self.fd);
@@ -926,29 +1114,10 @@ function Server(/* [ options, ] listener */) {
         return;
       }
 
-      self.connections++;
-
-      var options = { fd: peerInfo.fd,
-                      type: self.type,
-                      allowHalfOpen: self.allowHalfOpen };
-      var s = new Socket(options);
+      var s = self._newConnection(peerInfo.fd);
       s.remoteAddress = peerInfo.address;
       s.remotePort = peerInfo.port;
-      s.type = self.type;
-      s.server = self;
-      s.resume();
-
-      DTRACE_NET_SERVER_CONNECTION(s);
-      self.emit('connection', s);
-
-      // The 'connect' event  probably should be removed for server-side
-      // sockets. It's redundant.
-      try {
-        s.emit('connect');
-      } catch (e) {
-        s.destroy(e);
-        return;
-      }
+      if (!self._emitConnection(s)) return;
     }
   };
 }
@@ -961,6 +1130,89 @@ exports.createServer = function() {
 };
 
 
+Server.prototype._newConnection = function(fd) {
+  this.connections++;
+
+  var options = { fd: fd,
+                  type: this.type,
+                  allowHalfOpen: this.allowHalfOpen };
+  var s = new Socket(options);
+  s.type = this.type;
+  s.server = this;
+  return s;
+};
+
+
+// Returns false if the socket was destroyed by a 'connect' listener.
+Server.prototype._emitConnection = function(s) {
+  s.resume();
+
+  DTRACE_NET_SERVER_CONNECTION(s);
+  this.emit('connection', s);
+
+  // The 'connect' event  probably should be removed for server-side
+  // sockets. It's redundant.
+  try {
+    s.emit('connect');
+  } catch (e) {
+    s.destroy(e);
+    return false;
+  }
+  return true;
+};
+
+
+// Takes pending connections kAcceptBatch at a time, with accept4(2) where
+// there is one, and leaves their addresses raw until someone asks.
+Server.prototype._acceptMany = function() {
+  var self = this;
+
+  if (!this._peers) {
+    this._peers = new Int32Array(kAcceptBatch * kPeerStride);
+  }
+  var peers = this._peers;
+
+  while (typeof this.fd === 'number') {
+    try {
+      var count = acceptMany(this.fd, peers);
+    } catch (e) {
+      if (e.errno != EMFILE) throw e;
+
+      // Gracefully reject pending clients by freeing up a file
+      // descriptor.
+      rescueEMFILE(function() {
+        self._rejectPending();
+      });
+      return;
+    }
+    if (!count) return;
+
+    for (var i = 0; i < count; i++) {
+      var slot = i * kPeerStride;
+
+      if (this.maxConnections && this.connections >= this.maxConnections) {
+        // Close the connections we just had
+        for (; i < count; i++) {
+          close(peers[i * kPeerStride]);
+        }
+        // Reject all other pending connectins.
+        this._rejectPending();
+        return;
+      }
+
+      var s = this._newConnection(peers[slot]);
+      s.remotePort = peers[slot + 1];
+      s._peer = [peers[slot + 2], peers[slot + 3], peers[slot + 4],
+                 peers[slot + 5], peers[slot + 6]];
+
+      // Every connection in the batch is already open, so carry on even
+      // if this one was destroyed.
+      this._emitConnection(s);
+    }
+  }
+};
+
+
 // Just stop trying to accepting connections for a while.
 // Useful for throttling against DoS attacks.
 Server.prototype.pause = function(msecs) {
@@ -1089,6 +1341,9 @@ Server.prototype._doListen = function() {
   getDummyFD();
 
   try {
+    // Each process sharing the port binds its own socket, so there is no
+    // common accept queue for them all to wake up on.
+    if (self.reusePort && self.type != 'unix') setReusePort(self.fd, true);
     bind(self.fd, arguments[0], arguments[1]);
   } catch (err) {
     self.close();
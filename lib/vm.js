@@ -30,3 +30,4 @@ exports.createContext = binding.Script.createContext;
 exports.runInContext = binding.Script.runInContext;
 exports.runInThisContext = binding.Script.runInThisContext;
 exports.runInNewContext = binding.Script.runInNewContext;
+exports.runInSandbox = binding.Script.runInSandbox;
@@ -0,0 +1,67 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+
+var EventEmitter = require('events').EventEmitter;
+var fs = require('fs');
+var path = require('path');
+var util = require('util');
+var InternalWorker = process.binding('worker').Worker;
+
+
+// Runs the script at `filename` on a thread of its own. The script gets a
+// bare context with postMessage(), close() and an onmessage hook; none of
+// node's modules are available inside it.
+function Worker(filename) {
+  EventEmitter.call(this);
+
+  var self = this;
+  filename = path.resolve(filename);
+  var source = fs.readFileSync(filename, 'utf8');
+
+  this._handle = new InternalWorker(source, filename);
+
+  this._handle.onmessage = function(data) {
+    self.emit('message', data);
+  };
+
+  this._handle.onerror = function(message) {
+    self.emit('error', new Error(message));
+  };
+
+  this._handle.onexit = function() {
+    self._handle = null;
+    self.emit('exit');
+  };
+}
+util.inherits(Worker, EventEmitter);
+exports.Worker = Worker;
+
+
+Worker.prototype.postMessage = function(data) {
+  if (!this._handle) throw new Error('Worker has exited');
+  this._handle.postMessage(data);
+};
+
+
+Worker.prototype.terminate = function() {
+  if (this._handle) this._handle.terminate();
+};
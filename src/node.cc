@@ -97,6 +97,7 @@ static Persistent<String> rss_symbol;
 static Persistent<String> vsize_symbol;
 static Persistent<String> heap_total_symbol;
 static Persistent<String> heap_used_symbol;
+static Persistent<String> external_symbol;
 
 static Persistent<String> listeners_symbol;
 static Persistent<String> uncaught_exception_symbol;
@@ -109,6 +110,7 @@ static bool use_debug_agent = false;
 static bool debug_wait_connect = false;
 static int debug_port=5858;
 static int max_stack_size = 0;
+static int max_heap_size = 0;
 
 static ev_check check_tick_watcher;
 static ev_prepare prepare_tick_watcher;
@@ -126,8 +128,8 @@ static char getbuf[PATH_MAX + 1];
 
 // We need to notify V8 when we're idle so that it can run the garbage
 // collector. The interface to this is V8::IdleNotification(). It returns
-// true if the heap hasn't be fully compacted, and needs to be run again.
-// Returning false means that it doesn't have anymore work to do.
+// false if the heap hasn't be fully compacted, and needs to be run again.
+// Returning true means that it doesn't have anymore work to do.
 //
 // A rather convoluted algorithm has been devised to determine when Node is
 // idle. You'll have to figure it out for yourself.
@@ -140,7 +142,8 @@ bool need_gc;
 #define FAST_TICK 0.7
 #define GC_WAIT_TIME 5.
 #define RPM_SAMPLES 100
-#define TICK_TIME(n) tick_times[(tick_time_head - (n)) % RPM_SAMPLES]
+#define TICK_TIME(n) \
+  tick_times[(tick_time_head - (n) + RPM_SAMPLES) % RPM_SAMPLES]
 static ev_tstamp tick_times[RPM_SAMPLES];
 static int tick_time_head;
 
@@ -158,13 +161,25 @@ static void StopGCTimer () {
   }
 }
 
+// How many milliseconds of idle time to expect, from the mean gap between
+// the last few ticks. A loop that has been waking up often gets a small GC
+// budget; one that has been quiet can afford a full collection.
+static int IdleTimeHint() {
+  const int samples = 5;
+  double gap = (TICK_TIME(1) - TICK_TIME(samples + 1)) / samples;
+  int hint = static_cast<int>(gap * 1000);
+  if (hint < 1) return 1;
+  if (hint > 1000) return 1000;
+  return hint;
+}
+
 static void Idle(EV_P_ ev_idle *watcher, int revents) {
   assert(watcher == &gc_idle);
   assert(revents == EV_IDLE);
 
   //fprintf(stderr, "idle\n");
 
-  if (V8::IdleNotification()) {
+  if (V8::IdleNotification(IdleTimeHint())) {
     ev_idle_stop(EV_A_ watcher);
     StopGCTimer();
   }
@@ -1303,7 +1318,11 @@ Local<Value> ExecuteString(Handle<String> source, Handle<Value> filename) {
   HandleScope scope;
   TryCatch try_catch;
 
-  Local<v8::Script> script = v8::Script::Compile(source, filename);
+  // src/node.js is normally decoded from the build-time snapshot.
+  v8::ScriptData* snapshot = LoadNativeSnapshot(filename->ToString(), source);
+  v8::ScriptOrigin origin(filename);
+  Local<v8::Script> script = v8::Script::Compile(source, &origin, snapshot);
+  delete snapshot;
   if (script.IsEmpty()) {
     ReportException(try_catch, true);
     exit(1);
@@ -1553,6 +1572,7 @@ v8::Handle<v8::Value> MemoryUsage(const v8::Arguments& args) {
     vsize_symbol = NODE_PSYMBOL("vsize");
     heap_total_symbol = NODE_PSYMBOL("heapTotal");
     heap_used_symbol = NODE_PSYMBOL("heapUsed");
+    external_symbol = NODE_PSYMBOL("external");
   }
 
   info->Set(rss_symbol, Integer::NewFromUnsigned(rss));
@@ -1565,6 +1585,93 @@ v8::Handle<v8::Value> MemoryUsage(const v8::Arguments& args) {
             Integer::NewFromUnsigned(v8_heap_stats.total_heap_size()));
   info->Set(heap_used_symbol,
             Integer::NewFromUnsigned(v8_heap_stats.used_heap_size()));
+  // Memory held outside the heap, such as Buffer contents
+  info->Set(external_symbol,
+            Integer::New(V8::AdjustAmountOfExternalAllocatedMemory(0)));
+
+  return scope.Close(info);
+}
+
+
+// Returns one entry per compartment, breaking its memory down by the kind
+// of thing holding it. This walks the whole heap, so it is meant for
+// diagnosing growth rather than for polling.
+static Handle<Value> HeapBreakdown(const Arguments& args) {
+  HandleScope scope;
+
+  CompartmentHeapStatistics* stats;
+  size_t count = V8::GetCompartmentHeapStatistics(&stats);
+
+  Local<Array> result = Array::New(count);
+  for (size_t i = 0; i < count; i++) {
+    CompartmentHeapStatistics& c = stats[i];
+    Local<Object> entry = Object::New();
+    entry->Set(String::NewSymbol("name"), String::New(c.name()));
+    entry->Set(String::NewSymbol("objects"),
+               Integer::NewFromUnsigned(c.objects_size()));
+    entry->Set(String::NewSymbol("strings"),
+               Integer::NewFromUnsigned(c.strings_size()));
+    entry->Set(String::NewSymbol("shapes"),
+               Integer::NewFromUnsigned(c.shapes_size()));
+    entry->Set(String::NewSymbol("scripts"),
+               Integer::NewFromUnsigned(c.scripts_size()));
+    entry->Set(String::NewSymbol("typeInference"),
+               Integer::NewFromUnsigned(c.type_inference_size()));
+    entry->Set(String::NewSymbol("mjitCode"),
+               Integer::NewFromUnsigned(c.mjit_code_size()));
+    entry->Set(String::NewSymbol("unused"),
+               Integer::NewFromUnsigned(c.unused_size()));
+    result->Set(i, entry);
+  }
+  delete[] stats;
+
+  return scope.Close(result);
+}
+
+
+static Handle<Value> GCStats(const Arguments& args) {
+  HandleScope scope;
+
+  static const struct {
+    GCPhase phase;
+    const char* name;
+  } phases[] = {
+    { kGCPhaseMark, "mark" },
+    { kGCPhaseSweep, "sweep" },
+    { kGCPhaseSweepObjects, "sweepObjects" },
+    { kGCPhaseSweepStrings, "sweepStrings" },
+    { kGCPhaseSweepScripts, "sweepScripts" },
+    { kGCPhaseSweepShapes, "sweepShapes" },
+    { kGCPhaseDiscardCode, "discardCode" },
+    { kGCPhaseDestroy, "destroy" }
+  };
+
+  GCStatistics stats;
+  V8::GetGCStatistics(&stats);
+
+  // Times are kept in microseconds and reported in milliseconds.
+  Local<Object> info = Object::New();
+  info->Set(String::NewSymbol("count"),
+            Integer::NewFromUnsigned(stats.count()));
+  info->Set(String::NewSymbol("totalPause"),
+            Number::New(stats.total_pause() / 1000.0));
+  info->Set(String::NewSymbol("maxPause"),
+            Number::New(stats.max_pause() / 1000.0));
+  info->Set(String::NewSymbol("lastPause"),
+            Number::New(stats.last_pause() / 1000.0));
+
+  Local<Object> phaseTimes = Object::New();
+  for (size_t i = 0; i < sizeof(phases) / sizeof(phases[0]); i++) {
+    phaseTimes->Set(String::NewSymbol(phases[i].name),
+                    Number::New(stats.phase_time(phases[i].phase) / 1000.0));
+  }
+  info->Set(String::NewSymbol("phases"), phaseTimes);
+
+  Local<Array> histogram = Array::New(GCStatistics::kHistogramBuckets);
+  for (int i = 0; i < GCStatistics::kHistogramBuckets; i++) {
+    histogram->Set(i, Integer::NewFromUnsigned(stats.histogram(i)));
+  }
+  info->Set(String::NewSymbol("histogram"), histogram);
 
   return scope.Close(info);
 }
@@ -2073,6 +2180,8 @@ Handle<Object> SetupProcessObject(int argc, char *argv[]) {
 
   NODE_SET_METHOD(process, "uptime", Uptime);
   NODE_SET_METHOD(process, "memoryUsage", MemoryUsage);
+  NODE_SET_METHOD(process, "heapBreakdown", HeapBreakdown);
+  NODE_SET_METHOD(process, "gcStats", GCStats);
 
   NODE_SET_METHOD(process, "binding", Binding);
 
@@ -2178,6 +2287,8 @@ static void PrintHelp() {
          "  --v8-options         print v8 command line options\n"
          "  --vars               print various compiled-in variables\n"
          "  --max-stack-size=val set max v8 stack size (bytes)\n"
+         "  --max-heap-size=val  set max heap size (megabytes)\n"
+         "  --gc-mode=mode       global (default) or compartment\n"
          "\n"
          "Enviromental variables:\n"
          "NODE_PATH              ':'-separated list of directories\n"
@@ -2186,6 +2297,8 @@ static void PrintHelp() {
          "NODE_MODULE_CONTEXTS   Set to 1 to load modules in their own\n"
          "                       global contexts.\n"
          "NODE_DISABLE_COLORS    Set to 1 to disable colors in the REPL\n"
+         "NODE_COMPILE_CACHE     Directory in which compiled scripts are\n"
+         "                       cached between runs.\n"
          "\n"
          "Documentation can be found at http://nodejs.org/\n");
 }
@@ -2212,6 +2325,24 @@ static void ParseArgs(int argc, char **argv) {
       p = 1 + strchr(arg, '=');
       max_stack_size = atoi(p);
       argv[i] = const_cast<char*>("");
+    } else if (strstr(arg, "--max-heap-size=") == arg) {
+      const char *p = 0;
+      p = 1 + strchr(arg, '=');
+      max_heap_size = atoi(p);
+      // The limit is handed to the engine in bytes as an int.
+      if (max_heap_size <= 0 || max_heap_size > INT_MAX / (1024 * 1024)) {
+        fprintf(stderr, "Error: --max-heap-size must be between 1 and %d\n",
+                INT_MAX / (1024 * 1024));
+        exit(1);
+      }
+      argv[i] = const_cast<char*>("");
+    } else if (strstr(arg, "--gc-mode=") == arg) {
+      // Left in place for V8::SetFlagsFromCommandLine to apply.
+      const char *p = 1 + strchr(arg, '=');
+      if (strcmp(p, "global") != 0 && strcmp(p, "compartment") != 0) {
+        fprintf(stderr, "Error: --gc-mode must be global or compartment\n");
+        exit(1);
+      }
     } else if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
       PrintHelp();
       exit(0);
@@ -2312,12 +2443,15 @@ char** Init(int argc, char *argv[]) {
   // the address of a stack variable (e.g. &stack_var) as an approximation
   // of the start of the stack (we're assuming that we haven't pushed a lot
   // of frames yet).
-  if (node::max_stack_size != 0) {
+  if (node::max_stack_size != 0 || node::max_heap_size != 0) {
     uint32_t stack_var;
     ResourceConstraints constraints;
 
-    uint32_t *stack_limit = &stack_var - (node::max_stack_size / sizeof(uint32_t));
-    constraints.set_stack_limit(stack_limit);
+    if (node::max_stack_size != 0) {
+      uint32_t *stack_limit = &stack_var - (node::max_stack_size / sizeof(uint32_t));
+      constraints.set_stack_limit(stack_limit);
+    }
+    constraints.set_max_old_space_size(node::max_heap_size * 1024 * 1024);
     SetResourceConstraints(&constraints); // Must be done before V8::Initialize
   }
   V8::SetFlagsFromCommandLine(&v8argc, v8argv, false);
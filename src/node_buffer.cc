@@ -39,6 +39,7 @@
 #endif
 
 #include "jstypedarray.h"
+#include "jsproxy.h"
 
 
 #define MIN(a,b) ((a) < (b) ? (a) : (b))
@@ -62,7 +63,7 @@ using namespace v8;
     return ThrowException(Exception::Error(                          \
           String::New("Must have start <= end")));                   \
   }                                                                  \
-  if ((size_t)end > data_length_from_object(arr)) {             \
+  if ((size_t)end > buffer_length) {                                 \
     return ThrowException(Exception::Error(                          \
           String::New("end cannot be longer than parent.length")));  \
   }
@@ -74,11 +75,25 @@ static Persistent<String> write_sym;
 Persistent<FunctionTemplate> Buffer::constructor_template;
 
 
+// The proxies that lib/buffer.js wraps around a Buffer's Uint8Array keep
+// the array in this extra slot, so finding it doesn't run the get trap.
+// setRawArray also marks them in the other slot, so that no other proxy is
+// taken for a Buffer.
+static const size_t kRawArraySlot = 0;
+static const size_t kBufferTagSlot = 1;
+static char buffer_proxy_tag;
+
+
 static inline JSObject* typed_array_from_object(Handle<Object> obj) {
   JS_ASSERT(!obj.IsEmpty());
-  Local<Value> arr = obj->Get(String::NewSymbol("rawArray"));
-  if (arr->IsUndefined()) return NULL;
-  return **arr->ToObject();
+  JSObject* jo = **obj;
+  if (js_IsTypedArray(jo)) return jo;
+  if (!js::IsObjectProxy(jo)) return NULL;
+  const js::Value &tag = js::GetProxyExtra(jo, kBufferTagSlot);
+  if (!tag.isDouble() || tag.toPrivate() != &buffer_proxy_tag) return NULL;
+  const js::Value &arr = js::GetProxyExtra(jo, kRawArraySlot);
+  if (!arr.isObject() || !js_IsTypedArray(&arr.toObject())) return NULL;
+  return &arr.toObject();
 }
 
 
@@ -94,6 +109,34 @@ static inline uint32_t data_length_from_object(JSObject* obj) {
 }
 
 
+// Buffers are either typed arrays behind a proxy, or SlowBuffers made by
+// native code, which keep their bytes as external array data.
+static inline bool buffer_contents(Handle<Object> obj,
+                                   char** data,
+                                   size_t* length) {
+  JSObject* arr = typed_array_from_object(obj);
+  if (arr) {
+    if (js::TypedArray::getType(arr) != js::TypedArray::TYPE_UINT8) return false;
+    *data = (char*)data_from_object(arr);
+    *length = data_length_from_object(arr);
+    return true;
+  }
+  if (!Buffer::HasInstance(obj)) return false;
+  *data = (char*)obj->GetIndexedPropertiesExternalArrayData();
+  *length = obj->GetIndexedPropertiesExternalArrayDataLength();
+  return true;
+}
+
+
+#define THIS_BUFFER(data, length)                                    \
+  char* data;                                                        \
+  size_t length;                                                     \
+  if (!buffer_contents(args.This(), &data, &length)) {               \
+    return ThrowException(Exception::TypeError(                      \
+          String::New("Receiver must be a Buffer")));                \
+  }
+
+
 static inline size_t base64_decoded_size(const char *src, size_t size) {
   const char *const end = src + size;
   const int remainder = size % 4;
@@ -238,21 +281,28 @@ Buffer::Buffer(Handle<Object> wrapper, size_t length) : ObjectWrap() {
 }
 
 
+// Runs from the weak callback while the collector still owns the wrapper, so
+// only the contents are released and the object is left alone.
 Buffer::~Buffer() {
-  Replace(NULL, 0, NULL, NULL);
+  Release();
 }
 
 
-void Buffer::Replace(char *data, size_t length,
-                     free_callback callback, void *hint) {
-  HandleScope scope;
-
+void Buffer::Release() {
   if (callback_) {
     callback_(data_, callback_hint_);
   } else if (length_) {
     delete [] data_;
     V8::AdjustAmountOfExternalAllocatedMemory(-(sizeof(Buffer) + length_));
   }
+}
+
+
+void Buffer::Replace(char *data, size_t length,
+                     free_callback callback, void *hint) {
+  HandleScope scope;
+
+  Release();
 
   length_ = length;
   callback_ = callback;
@@ -278,10 +328,10 @@ void Buffer::Replace(char *data, size_t length,
 
 Handle<Value> Buffer::BinarySlice(const Arguments &args) {
   HandleScope scope;
-  JSObject* arr = typed_array_from_object(args.This());
+  THIS_BUFFER(buffer_data, buffer_length)
   SLICE_ARGS(args[0], args[1])
 
-  char* data = (char*)data_from_object(arr) + start;
+  char* data = buffer_data + start;
   //Local<String> string = String::New(data, end - start);
 
   Local<Value> b =  Encode(data, end - start, BINARY);
@@ -292,9 +342,9 @@ Handle<Value> Buffer::BinarySlice(const Arguments &args) {
 
 Handle<Value> Buffer::AsciiSlice(const Arguments &args) {
   HandleScope scope;
-  JSObject* arr = typed_array_from_object(args.This());
+  THIS_BUFFER(buffer_data, buffer_length)
   SLICE_ARGS(args[0], args[1])
-  char* data = (char*)data_from_object(arr) + start;
+  char* data = buffer_data + start;
 
   Local<String> string = String::New(data, end - start);
 
@@ -304,18 +354,18 @@ Handle<Value> Buffer::AsciiSlice(const Arguments &args) {
 
 Handle<Value> Buffer::Utf8Slice(const Arguments &args) {
   HandleScope scope;
-  JSObject* arr = typed_array_from_object(args.This());
+  THIS_BUFFER(buffer_data, buffer_length)
   SLICE_ARGS(args[0], args[1]);
-  char* data = (char*)data_from_object(arr) + start;
+  char* data = buffer_data + start;
   Local<String> string = String::New(data, end - start);
   return scope.Close(string);
 }
 
 Handle<Value> Buffer::Ucs2Slice(const Arguments &args) {
   HandleScope scope;
-  JSObject* arr = typed_array_from_object(args.This());
+  THIS_BUFFER(buffer_data, buffer_length)
   SLICE_ARGS(args[0], args[1])
-  uint16_t *data = (uint16_t*)data_from_object(arr) + start;
+  uint16_t *data = (uint16_t*)buffer_data + start;
   Local<String> string = String::New(data, (end - start) / 2);
   return scope.Close(string);
 }
@@ -346,9 +396,9 @@ static const int unbase64_table[] =
 
 Handle<Value> Buffer::Base64Slice(const Arguments &args) {
   HandleScope scope;
-  JSObject* arr = typed_array_from_object(args.This());
+  THIS_BUFFER(buffer_data, buffer_length)
   SLICE_ARGS(args[0], args[1])
-  char* data = (char*)data_from_object(arr) + start;
+  char* data = buffer_data + start;
 
   int n = end - start;
   int out_len = (n + 2 - ((n + 2) % 3)) / 3 * 4;
@@ -420,6 +470,7 @@ Handle<Value> Buffer::Base64Slice(const Arguments &args) {
 // var bytesCopied = buffer.copy(target, targetStart, sourceStart, sourceEnd);
 Handle<Value> Buffer::Copy(const Arguments &args) {
   HandleScope scope;
+  THIS_BUFFER(buffer_data, buffer_length)
 
   if (!Buffer::HasInstance(args[0])) {
     return ThrowException(Exception::TypeError(String::New(
@@ -433,7 +484,7 @@ Handle<Value> Buffer::Copy(const Arguments &args) {
   ssize_t target_start = args[1]->Int32Value();
   ssize_t source_start = args[2]->Int32Value();
   ssize_t source_end = args[3]->IsInt32() ? args[3]->Int32Value()
-                                          : Buffer::Length(args.This());
+                                          : buffer_length;
 
   if (source_end < source_start) {
     return ThrowException(Exception::Error(String::New(
@@ -450,24 +501,24 @@ Handle<Value> Buffer::Copy(const Arguments &args) {
             "targetStart out of bounds")));
   }
 
-  if (source_start < 0 || source_start >= Buffer::Length(args.This())) {
+  if (source_start < 0 || source_start >= buffer_length) {
     return ThrowException(Exception::Error(String::New(
             "sourceStart out of bounds")));
   }
 
-  if (source_end < 0 || source_end > Buffer::Length(args.This())) {
+  if (source_end < 0 || source_end > buffer_length) {
     return ThrowException(Exception::Error(String::New(
             "sourceEnd out of bounds")));
   }
 
   ssize_t to_copy = MIN(MIN(source_end - source_start,
                             target_length - target_start),
-                            Buffer::Length(args.This()) - source_start);
+                            buffer_length - source_start);
 
 
   // need to use slightly slower memmove is the ranges might overlap
   memmove((void *)(target_data + target_start),
-          (const void*)(Buffer::Data(args.This()) + source_start),
+          (const void*)(buffer_data + source_start),
           to_copy);
 
   return scope.Close(Integer::New(to_copy));
@@ -477,9 +528,7 @@ Handle<Value> Buffer::Copy(const Arguments &args) {
 // var charsWritten = buffer.utf8Write(string, offset, [maxLength]);
 Handle<Value> Buffer::Utf8Write(const Arguments &args) {
   HandleScope scope;
-  Local<Object> buffer = args.This()->Get(String::NewSymbol("rawArray"))->ToObject();
-  char* data = (char*)data_from_object(**buffer);
-  int32_t length = data_length_from_object(**buffer);
+  THIS_BUFFER(data, length)
 
   if (!args[0]->IsString()) {
     return ThrowException(Exception::TypeError(String::New(
@@ -520,8 +569,7 @@ Handle<Value> Buffer::Utf8Write(const Arguments &args) {
 // var charsWritten = buffer.ucs2Write(string, offset, [maxLength]);
 Handle<Value> Buffer::Ucs2Write(const Arguments &args) {
   HandleScope scope;
-  char* buffer_data = Buffer::Data(args.This());
-  size_t buffer_length = Buffer::Length(args.This());
+  THIS_BUFFER(buffer_data, buffer_length)
 
   if (!args[0]->IsString()) {
     return ThrowException(Exception::TypeError(String::New(
@@ -554,6 +602,7 @@ Handle<Value> Buffer::Ucs2Write(const Arguments &args) {
 // var charsWritten = buffer.asciiWrite(string, offset);
 Handle<Value> Buffer::AsciiWrite(const Arguments &args) {
   HandleScope scope;
+  THIS_BUFFER(buffer_data, buffer_length)
 
   if (!args[0]->IsString()) {
     return ThrowException(Exception::TypeError(String::New(
@@ -564,16 +613,16 @@ Handle<Value> Buffer::AsciiWrite(const Arguments &args) {
 
   size_t offset = args[1]->Int32Value();
 
-  if (s->Length() > 0 && offset >= Buffer::Length(args.This())) {
+  if (s->Length() > 0 && offset >= buffer_length) {
     return ThrowException(Exception::TypeError(String::New(
             "Offset is out of bounds")));
   }
 
-  size_t max_length = args[2]->IsUndefined() ? Buffer::Length(args.This()) - offset
+  size_t max_length = args[2]->IsUndefined() ? buffer_length - offset
                                              : args[2]->Uint32Value();
-  max_length = MIN(s->Length(), MIN(Buffer::Length(args.This()) - offset, max_length));
+  max_length = MIN(s->Length(), MIN(buffer_length - offset, max_length));
 
-  char *p = Buffer::Data(args.This()) + offset;
+  char *p = buffer_data + offset;
 
   int written = s->WriteAscii(p,
                               0,
@@ -598,8 +647,7 @@ Handle<Value> Buffer::Base64Write(const Arguments &args) {
   assert(unbase64('\n') == -2);
   assert(unbase64('\r') == -2);
 
-  char* buffer_data = Buffer::Data(args.This());
-  size_t buffer_length = Buffer::Length(args.This());
+  THIS_BUFFER(buffer_data, buffer_length)
 
   if (!args[0]->IsString()) {
     return ThrowException(Exception::TypeError(String::New(
@@ -673,9 +721,7 @@ Handle<Value> Buffer::Base64Write(const Arguments &args) {
 
 Handle<Value> Buffer::BinaryWrite(const Arguments &args) {
   HandleScope scope;
-
-  char* buffer_data = Buffer::Data(args.This());
-  size_t buffer_length = Buffer::Length(args.This());
+  THIS_BUFFER(buffer_data, buffer_length)
 
   if (!args[0]->IsString()) {
     return ThrowException(Exception::TypeError(String::New(
@@ -732,32 +778,48 @@ Handle<Value> Buffer::MakeFastBuffer(const Arguments &args) {
 }
 
 
-bool Buffer::HasInstance(v8::Handle<v8::Value> val) {
-  if (!val->IsObject()) return false;
-  JSObject* jo = typed_array_from_object(val->ToObject());
-  if (!jo) return false;
-  Value v(OBJECT_TO_JSVAL(jo));
-  v8::Local<v8::Object> obj = Local<Value>::New(&v)->ToObject();
-  if (obj.IsEmpty()) return false;
+// SetRawArray(proxy, array)
+Handle<Value> Buffer::SetRawArray(const Arguments &args) {
+  HandleScope scope;
 
-  if (obj->GetIndexedPropertiesExternalArrayDataType() == kExternalUnsignedByteArray)
-    return true;
+  if (!args[0]->IsObject() || !args[1]->IsObject()) {
+    return ThrowException(Exception::TypeError(String::New("Bad argument")));
+  }
+  JSObject* proxy = **args[0]->ToObject();
+  JSObject* arr = **args[1]->ToObject();
+  if (!js::IsObjectProxy(proxy) || !js_IsTypedArray(arr)) {
+    return ThrowException(Exception::TypeError(String::New("Bad argument")));
+  }
 
-  // Also check for SlowBuffers that are empty.
-  if (constructor_template->HasInstance(obj))
-    return true;
+  js::SetProxyExtra(proxy, kRawArraySlot, js::ObjectValue(*arr));
+  js::SetProxyExtra(proxy, kBufferTagSlot, js::PrivateValue(&buffer_proxy_tag));
+  return Undefined();
+}
+
+
+bool Buffer::HasInstance(v8::Handle<v8::Value> val) {
+  if (!val->IsObject()) return false;
+  Local<Object> obj = val->ToObject();
+  JSObject* jo = typed_array_from_object(obj);
+  if (jo) return js::TypedArray::getType(jo) == js::TypedArray::TYPE_UINT8;
 
-  return false;
+  // Also check for SlowBuffers, including empty ones.
+  return constructor_template->HasInstance(obj) &&
+         obj->HasIndexedPropertiesInExternalArrayData();
 }
 
 
 char* Buffer::Data(v8::Handle<v8::Object> obj) {
-  return (char*)data_from_object(typed_array_from_object(obj));
+  char* data;
+  size_t length;
+  return buffer_contents(obj, &data, &length) ? data : NULL;
 }
 
 
 size_t Buffer::Length(v8::Handle<v8::Object> obj) {
-  return (size_t)data_length_from_object(typed_array_from_object(obj));
+  char* data;
+  size_t length;
+  return buffer_contents(obj, &data, &length) ? length : 0;
 }
 
 
@@ -796,6 +858,9 @@ void Buffer::Initialize(Handle<Object> target) {
                   Buffer::MakeFastBuffer);
 
   target->Set(String::NewSymbol("SlowBuffer"), constructor_template->GetFunction());
+  // Only lib/buffer.js may attach storage to a proxy, so this stays off
+  // SlowBuffer where scripts could reach it.
+  NODE_SET_METHOD(target, "setRawArray", Buffer::SetRawArray);
 }
 
 
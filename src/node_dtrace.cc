@@ -42,6 +42,8 @@
 #define NODE_NET_SOCKET_WRITE_ENABLED() (0)
 #define NODE_GC_START(arg0, arg1)
 #define NODE_GC_DONE(arg0, arg1)
+#define NODE_GC_PAUSE(arg0, arg1, arg2, arg3)
+#define NODE_GC_PAUSE_ENABLED() (0)
 #endif
 
 namespace node {
@@ -273,6 +275,18 @@ static int dtrace_gc_start(GCType type, GCCallbackFlags flags) {
 
 static int dtrace_gc_done(GCType type, GCCallbackFlags flags) {
   NODE_GC_DONE(type, flags);
+
+  /*
+   * The same numbers process.gcStats() adds up, for one collection:
+   * its sequence number and pause, mark and sweep times in microseconds.
+   */
+  if (NODE_GC_PAUSE_ENABLED()) {
+    GCStatistics stats;
+    V8::GetGCStatistics(&stats);
+    NODE_GC_PAUSE(stats.count(), stats.last_pause(),
+                  stats.last_phase_time(kGCPhaseMark),
+                  stats.last_phase_time(kGCPhaseSweep));
+  }
   return 0;
 }
 
@@ -0,0 +1,288 @@
+// Generated by tools/gen_http_headers.py.  Do not edit.
+
+#ifndef NODE_HTTP_HEADERS_H_
+#define NODE_HTTP_HEADERS_H_
+
+#include <stddef.h>
+
+namespace node {
+
+enum HeaderPolicy { HEADER_FIRST, HEADER_JOIN, HEADER_ARRAY };
+
+struct KnownHeader {
+  const char *name;
+  size_t length;
+  HeaderPolicy policy;
+};
+
+static const int kKnownHeaderSlots = 256;
+
+// Takes the header name lowercased.
+static inline unsigned HeaderHash(const char *name, size_t n) {
+  const unsigned char *s = reinterpret_cast<const unsigned char*>(name);
+  return (n * 1 + s[0] * 2 + s[n - 1] * 22 + s[n / 2] * 3) %
+         kKnownHeaderSlots;
+}
+
+static const KnownHeader kKnownHeaders[kKnownHeaderSlots] = {
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "dnt", 3, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "user-agent", 10, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "warning", 7, HEADER_FIRST },
+  { "server", 6, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "max-forwards", 12, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "x-forwarded-for", 15, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "x-forwarded-host", 16, HEADER_JOIN },
+  { "host", 4, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "status", 6, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "refresh", 7, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "accept-ranges", 13, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "retry-after", 11, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "cache-control", 13, HEADER_FIRST },
+  { "allow", 5, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "content-length", 14, HEADER_FIRST },
+  { "x-requested-with", 16, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "link", 4, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "transfer-encoding", 17, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "connection", 10, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "pragma", 6, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "from", 4, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "authorization", 13, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "via", 3, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "content-disposition", 19, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "origin", 6, HEADER_FIRST },
+  { "content-location", 16, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "access-control-allow-origin", 27, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "proxy-authorization", 19, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "age", 3, HEADER_FIRST },
+  { "content-md5", 11, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "if-range", 8, HEADER_FIRST },
+  { "vary", 4, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "proxy-connection", 16, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "location", 8, HEADER_FIRST },
+  { "keep-alive", 10, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "strict-transport-security", 25, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "x-forwarded-proto", 17, HEADER_JOIN },
+  { "x-powered-by", 12, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "cookie", 6, HEADER_JOIN },
+  { "x-real-ip", 9, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "accept-language", 15, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { "if-unmodified-since", 19, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "te", 2, HEADER_FIRST },
+  { "content-language", 16, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "last-modified", 13, HEADER_FIRST },
+  { "etag", 4, HEADER_FIRST },
+  { "if-modified-since", 17, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "date", 4, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "proxy-authenticate", 18, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "accept-encoding", 15, HEADER_JOIN },
+  { "www-authenticate", 16, HEADER_FIRST },
+  { "content-type", 12, HEADER_FIRST },
+  { "content-range", 13, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "content-encoding", 16, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "range", 5, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "referer", 7, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "set-cookie", 10, HEADER_ARRAY },
+  { NULL, 0, HEADER_FIRST },
+  { "if-match", 8, HEADER_FIRST },
+  { "expires", 7, HEADER_FIRST },
+  { "accept", 6, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { "accept-charset", 14, HEADER_JOIN },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "upgrade", 7, HEADER_FIRST },
+  { "trailer", 7, HEADER_FIRST },
+  { "expect", 6, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+  { "if-none-match", 13, HEADER_FIRST },
+  { NULL, 0, HEADER_FIRST },
+};
+
+}  // namespace node
+
+#endif  // NODE_HTTP_HEADERS_H_
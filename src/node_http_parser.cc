@@ -20,6 +20,7 @@
 // USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <node_http_parser.h>
+#include <node_http_headers.h>
 
 #include <v8.h>
 #include <node.h>
@@ -41,6 +42,13 @@
 //     ...
 // No copying is performed when slicing the buffer, only small reference
 // allocations.
+//
+// The URL and headers are the exception.  Unless the parser object has
+// onURL, onHeaderField or onHeaderValue callbacks of its own, they are
+// collected here and handed over as strings in onHeadersComplete, so a
+// request costs a handful of calls into javascript however many headers it
+// has.  Header names arrive lowercased, and the common ones as interned
+// strings, along with how javascript should treat a repeated header.
 
 
 namespace node {
@@ -54,6 +62,7 @@ static Persistent<String> on_url_sym;
 static Persistent<String> on_fragment_sym;
 static Persistent<String> on_header_field_sym;
 static Persistent<String> on_header_value_sym;
+static Persistent<String> on_headers_sym;
 static Persistent<String> on_headers_complete_sym;
 static Persistent<String> on_body_sym;
 static Persistent<String> on_message_complete_sym;
@@ -90,6 +99,11 @@ static Persistent<String> version_major_sym;
 static Persistent<String> version_minor_sym;
 static Persistent<String> should_keep_alive_sym;
 static Persistent<String> upgrade_sym;
+static Persistent<String> headers_sym;
+static Persistent<String> url_sym;
+
+// Lowercase names of the headers in kKnownHeaders, in the same slots.
+static Persistent<String> known_header_syms[kKnownHeaderSlots];
 
 static struct http_parser_settings settings;
 
@@ -102,45 +116,72 @@ static char* current_buffer_data;
 static size_t current_buffer_len;
 
 
-// Callback prototype for http_cb
-#define DEFINE_HTTP_CB(name)                                             \
-  static int name(http_parser *p) {                                      \
-    Parser *parser = static_cast<Parser*>(p->data);                      \
-    Local<Value> cb_value = parser->handle_->Get(name##_sym);            \
-    if (!cb_value->IsFunction()) return 0;                               \
-    Local<Function> cb = Local<Function>::Cast(cb_value);                \
-    Local<Value> ret = cb->Call(parser->handle_, 0, NULL);               \
-    if (ret.IsEmpty()) {                                                 \
-      parser->got_exception_ = true;                                     \
-      return -1;                                                         \
-    } else {                                                             \
-      return 0;                                                          \
-    }                                                                    \
-  }
-
 // Callback prototype for http_data_cb
 #define DEFINE_HTTP_DATA_CB(name)                                        \
   static int name(http_parser *p, const char *at, size_t length) {       \
-    Parser *parser = static_cast<Parser*>(p->data);                      \
-    assert(current_buffer);                                              \
-    Local<Value> cb_value = parser->handle_->Get(name##_sym);            \
-    if (!cb_value->IsFunction()) return 0;                               \
-    Local<Function> cb = Local<Function>::Cast(cb_value);                \
-    Local<Value> argv[3] = { *current_buffer                             \
-                           , Integer::New(at - current_buffer_data)      \
-                           , Integer::New(length)                        \
-                           };                                            \
-    Local<Value> ret = cb->Call(parser->handle_, 3, argv);               \
-    assert(current_buffer);                                              \
-    if (ret.IsEmpty()) {                                                 \
-      parser->got_exception_ = true;                                     \
-      return -1;                                                         \
-    } else {                                                             \
-      return 0;                                                          \
-    }                                                                    \
+    return DataCallback(p, name##_sym, at, length);                      \
   }
 
 
+// Header fields and values collected before they're handed to javascript.
+// Every header is delivered at once, but http_parser can deliver one in
+// several pieces, even across calls to execute().  So this points into the
+// buffer being parsed for as long as the pieces are contiguous.  Otherwise,
+// or when execute() returns, it copies them onto the heap.
+struct StringPtr {
+  StringPtr() : str_(NULL), on_heap_(false), size_(0) {}
+
+  ~StringPtr() {
+    Reset();
+  }
+
+  void Reset() {
+    if (on_heap_) {
+      delete[] str_;
+      on_heap_ = false;
+    }
+    str_ = NULL;
+    size_ = 0;
+  }
+
+  // The buffer is only borrowed while execute() runs.
+  void Save() {
+    if (!on_heap_ && size_ > 0) {
+      char *s = new char[size_];
+      memcpy(s, str_, size_);
+      str_ = s;
+      on_heap_ = true;
+    }
+  }
+
+  void Update(const char *str, size_t size) {
+    if (str_ == NULL) {
+      str_ = str;
+    } else if (on_heap_ || str_ + size_ != str) {
+      char *s = new char[size_ + size];
+      memcpy(s, str_, size_);
+      memcpy(s + size_, str, size);
+      if (on_heap_) {
+        delete[] str_;
+      } else {
+        on_heap_ = true;
+      }
+      str_ = s;
+    }
+    size_ += size;
+  }
+
+  Local<String> ToString() const {
+    if (str_) return String::New(str_, size_);
+    return String::Empty();
+  }
+
+  const char *str_;
+  bool on_heap_;
+  size_t size_;
+};
+
+
 static inline Persistent<String>
 method_to_str(unsigned short m) {
   switch (m) {
@@ -181,17 +222,74 @@ class Parser : public ObjectWrap {
   ~Parser() {
   }
 
-  DEFINE_HTTP_CB(on_message_begin)
-  DEFINE_HTTP_CB(on_message_complete)
-
   DEFINE_HTTP_DATA_CB(on_path)
-  DEFINE_HTTP_DATA_CB(on_url)
   DEFINE_HTTP_DATA_CB(on_fragment)
   DEFINE_HTTP_DATA_CB(on_query_string)
-  DEFINE_HTTP_DATA_CB(on_header_field)
-  DEFINE_HTTP_DATA_CB(on_header_value)
   DEFINE_HTTP_DATA_CB(on_body)
 
+  static int on_message_begin(http_parser *p) {
+    Parser *parser = static_cast<Parser*>(p->data);
+
+    // A parser that wants the pieces as they come keeps getting them.
+    parser->collect_url_ =
+      !parser->handle_->Get(on_url_sym)->IsFunction();
+    parser->collect_headers_ =
+      !parser->handle_->Get(on_header_field_sym)->IsFunction() &&
+      !parser->handle_->Get(on_header_value_sym)->IsFunction();
+
+    parser->url_.Reset();
+    parser->num_fields_ = parser->num_values_ = 0;
+
+    return Callback(p, on_message_begin_sym);
+  }
+
+  static int on_url(http_parser *p, const char *at, size_t length) {
+    Parser *parser = static_cast<Parser*>(p->data);
+    if (!parser->collect_url_) return DataCallback(p, on_url_sym, at, length);
+    parser->url_.Update(at, length);
+    return 0;
+  }
+
+  static int on_header_field(http_parser *p, const char *at, size_t length) {
+    Parser *parser = static_cast<Parser*>(p->data);
+    if (!parser->collect_headers_) {
+      return DataCallback(p, on_header_field_sym, at, length);
+    }
+
+    if (parser->num_fields_ == parser->num_values_) {
+      // The start of a new field.
+      if (parser->num_fields_ == kMaxHeaderFields) {
+        if (!parser->Flush()) return -1;
+      }
+      parser->fields_[parser->num_fields_].Reset();
+      parser->values_[parser->num_fields_].Reset();
+      parser->num_fields_++;
+    }
+    parser->fields_[parser->num_fields_ - 1].Update(at, length);
+    return 0;
+  }
+
+  static int on_header_value(http_parser *p, const char *at, size_t length) {
+    Parser *parser = static_cast<Parser*>(p->data);
+    if (!parser->collect_headers_) {
+      return DataCallback(p, on_header_value_sym, at, length);
+    }
+
+    if (parser->num_fields_ == 0) return 0;
+    parser->num_values_ = parser->num_fields_;
+    parser->values_[parser->num_values_ - 1].Update(at, length);
+    return 0;
+  }
+
+  static int on_message_complete(http_parser *p) {
+    Parser *parser = static_cast<Parser*>(p->data);
+
+    // Trailers, which come after the body.
+    if (parser->num_fields_ > 0 && !parser->Flush()) return -1;
+
+    return Callback(p, on_message_complete_sym);
+  }
+
   static int on_headers_complete(http_parser *p) {
     Parser *parser = static_cast<Parser*>(p->data);
 
@@ -202,6 +300,15 @@ class Parser : public ObjectWrap {
 
     Local<Object> message_info = Object::New();
 
+    // HEADERS and URL
+    if (parser->collect_headers_) {
+      message_info->Set(headers_sym, parser->TakeHeaders());
+    }
+    if (parser->collect_url_ && p->type == HTTP_REQUEST) {
+      message_info->Set(url_sym, parser->url_.ToString());
+      parser->url_.Reset();
+    }
+
     // METHOD
     if (p->type == HTTP_REQUEST) {
       message_info->Set(method_sym, method_to_str(p->method));
@@ -300,6 +407,8 @@ class Parser : public ObjectWrap {
     size_t nparsed =
       http_parser_execute(&parser->parser_, &settings, buffer_data + off, len);
 
+    parser->Save();
+
     // Unassign the 'buffer_' variable
     assert(current_buffer);
     current_buffer = NULL;
@@ -363,13 +472,138 @@ class Parser : public ObjectWrap {
 
  private:
 
+  // Headers beyond this many are passed to onHeaders() in batches.
+  static const int kMaxHeaderFields = 32;
+
+  static int Callback(http_parser *p, Handle<String> sym) {
+    Parser *parser = static_cast<Parser*>(p->data);
+    Local<Value> cb_value = parser->handle_->Get(sym);
+    if (!cb_value->IsFunction()) return 0;
+    Local<Function> cb = Local<Function>::Cast(cb_value);
+    Local<Value> ret = cb->Call(parser->handle_, 0, NULL);
+    if (ret.IsEmpty()) {
+      parser->got_exception_ = true;
+      return -1;
+    } else {
+      return 0;
+    }
+  }
+
+  static int DataCallback(http_parser *p, Handle<String> sym,
+                          const char *at, size_t length) {
+    Parser *parser = static_cast<Parser*>(p->data);
+    assert(current_buffer);
+    Local<Value> cb_value = parser->handle_->Get(sym);
+    if (!cb_value->IsFunction()) return 0;
+    Local<Function> cb = Local<Function>::Cast(cb_value);
+    Local<Value> argv[3] = { *current_buffer
+                           , Integer::New(at - current_buffer_data)
+                           , Integer::New(length)
+                           };
+    Local<Value> ret = cb->Call(parser->handle_, 3, argv);
+    assert(current_buffer);
+    if (ret.IsEmpty()) {
+      parser->got_exception_ = true;
+      return -1;
+    } else {
+      return 0;
+    }
+  }
+
   void Init (enum http_parser_type type) {
     http_parser_init(&parser_, type);
     parser_.data = this;
+    collect_url_ = collect_headers_ = false;
+    url_.Reset();
+    num_fields_ = num_values_ = 0;
+  }
+
+  // The header name lowercased, and how a repeat of it is handled.  Common
+  // names come from the table, so they cost no allocation.
+  static Handle<String> HeaderName(const StringPtr &field,
+                                   HeaderPolicy *policy) {
+    size_t n = field.size_;
+    *policy = HEADER_FIRST;
+    if (n == 0) return String::Empty();
+
+    char stack_buf[64];
+    char *lower = n <= sizeof(stack_buf) ? stack_buf : new char[n];
+    for (size_t i = 0; i < n; i++) {
+      char c = field.str_[i];
+      lower[i] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+
+    Handle<String> name;
+    unsigned slot = HeaderHash(lower, n);
+    const KnownHeader &known = kKnownHeaders[slot];
+    if (known.name && known.length == n && !memcmp(known.name, lower, n)) {
+      *policy = known.policy;
+      name = known_header_syms[slot];
+    } else {
+      // Extension headers are always joined.
+      if (n >= 2 && lower[0] == 'x' && lower[1] == '-') *policy = HEADER_JOIN;
+      name = String::New(lower, n);
+    }
+
+    if (lower != stack_buf) delete[] lower;
+    return name;
+  }
+
+  // [name, value, policy, name, value, policy, ...] for the headers
+  // collected so far.
+  Local<Array> TakeHeaders() {
+    Local<Array> headers = Array::New(3 * num_fields_);
+    for (int i = 0; i < num_fields_; i++) {
+      HeaderPolicy policy;
+      headers->Set(3 * i, HeaderName(fields_[i], &policy));
+      headers->Set(3 * i + 1, values_[i].ToString());
+      headers->Set(3 * i + 2, Integer::New(policy));
+    }
+    num_fields_ = num_values_ = 0;
+    return headers;
+  }
+
+  // Hands the headers collected so far, and the URL, to onHeaders().
+  bool Flush() {
+    HandleScope scope;
+
+    Local<Value> cb_value = handle_->Get(on_headers_sym);
+    if (!cb_value->IsFunction()) {
+      num_fields_ = num_values_ = 0;
+      return true;
+    }
+    Local<Function> cb = Local<Function>::Cast(cb_value);
+
+    Local<Value> argv[2] = { TakeHeaders(), url_.ToString() };
+    url_.Reset();
+
+    Local<Value> ret = cb->Call(handle_, 2, argv);
+    if (ret.IsEmpty()) {
+      got_exception_ = true;
+      return false;
+    }
+    return true;
+  }
+
+  // Copies whatever still points into the buffer that was just parsed.
+  void Save() {
+    url_.Save();
+    for (int i = 0; i < num_fields_; i++) {
+      fields_[i].Save();
+      values_[i].Save();
+    }
   }
 
   bool got_exception_;
   http_parser parser_;
+
+  bool collect_url_;
+  bool collect_headers_;
+  StringPtr url_;
+  StringPtr fields_[kMaxHeaderFields];
+  StringPtr values_[kMaxHeaderFields];
+  int num_fields_;
+  int num_values_;
 };
 
 
@@ -386,6 +620,10 @@ void InitHttpParser(Handle<Object> target) {
 
   target->Set(String::NewSymbol("HTTPParser"), t->GetFunction());
 
+  NODE_DEFINE_CONSTANT(target, HEADER_FIRST);
+  NODE_DEFINE_CONSTANT(target, HEADER_JOIN);
+  NODE_DEFINE_CONSTANT(target, HEADER_ARRAY);
+
   on_message_begin_sym    = NODE_PSYMBOL("onMessageBegin");
   on_path_sym             = NODE_PSYMBOL("onPath");
   on_query_string_sym     = NODE_PSYMBOL("onQueryString");
@@ -393,6 +631,7 @@ void InitHttpParser(Handle<Object> target) {
   on_fragment_sym         = NODE_PSYMBOL("onFragment");
   on_header_field_sym     = NODE_PSYMBOL("onHeaderField");
   on_header_value_sym     = NODE_PSYMBOL("onHeaderValue");
+  on_headers_sym          = NODE_PSYMBOL("onHeaders");
   on_headers_complete_sym = NODE_PSYMBOL("onHeadersComplete");
   on_body_sym             = NODE_PSYMBOL("onBody");
   on_message_complete_sym = NODE_PSYMBOL("onMessageComplete");
@@ -429,6 +668,14 @@ void InitHttpParser(Handle<Object> target) {
   version_minor_sym = NODE_PSYMBOL("versionMinor");
   should_keep_alive_sym = NODE_PSYMBOL("shouldKeepAlive");
   upgrade_sym = NODE_PSYMBOL("upgrade");
+  headers_sym = NODE_PSYMBOL("headers");
+  url_sym = NODE_PSYMBOL("url");
+
+  for (int i = 0; i < kKnownHeaderSlots; i++) {
+    if (kKnownHeaders[i].name) {
+      known_header_syms[i] = NODE_PSYMBOL(kKnownHeaders[i].name);
+    }
+  }
 
   settings.on_message_begin    = Parser::on_message_begin;
   settings.on_path             = Parser::on_path;
@@ -28,10 +28,17 @@
 
 using namespace v8;
 
+#ifdef MOZILLA_JS
+# define BUILTIN_SOURCE(array, len) BUILTIN_TWO_BYTE_ARRAY(array, len)
+#else
+# define BUILTIN_SOURCE(array, len) BUILTIN_ASCII_ARRAY(array, len)
+#endif
+
 namespace node {
 
 Handle<String> MainSource() {
-  return BUILTIN_ASCII_ARRAY(node_native, sizeof(node_native)-1);
+  return BUILTIN_SOURCE(node_native,
+                        sizeof(node_native) / sizeof(native_char) - 1);
 }
 
 void DefineJavaScript(v8::Handle<v8::Object> target) {
@@ -40,7 +47,7 @@ void DefineJavaScript(v8::Handle<v8::Object> target) {
   for (int i = 0; natives[i].name; i++) {
     if (natives[i].source != node_native) {
       Local<String> name = String::New(natives[i].name);
-      Handle<String> source = BUILTIN_ASCII_ARRAY(natives[i].source, natives[i].source_len);
+      Handle<String> source = BUILTIN_SOURCE(natives[i].source, natives[i].source_len);
       target->Set(name, source);
     }
   }
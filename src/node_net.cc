@@ -27,6 +27,7 @@
 #include <v8.h>
 
 #include <errno.h>
+#include <limits.h> /* IOV_MAX */
 #include <string.h>
 #include <stdlib.h>
 
@@ -47,6 +48,7 @@
 # include <netdb.h>
 # include <netinet/in.h>
 # include <netinet/tcp.h>
+# include <sys/uio.h> /* writev */
 #endif
 
 #ifdef __linux__
@@ -58,8 +60,8 @@
 # include <sys/filio.h>
 #endif
 
-#ifdef __OpenBSD__
-# include <sys/uio.h>
+#ifndef IOV_MAX
+# define IOV_MAX 1024
 #endif
 
 /*
@@ -625,7 +627,7 @@ static Handle<Value> GetSockFamily(const Arguments& args) {
     default:
       result = Integer::New((address_storage).ss_family);
   }
-  scope.Close(result);
+  return scope.Close(result);
 }
 
 static Handle<Value> GetPeerName(const Arguments& args) {
@@ -731,6 +733,125 @@ static Handle<Value> Accept(const Arguments& args) {
 }
 
 
+#ifdef __POSIX__
+
+// Each accepted connection takes this many int32 slots of the array passed
+// to acceptMany: fd, port, address family and 16 bytes of raw address.
+static const int kPeerStride = 7;
+
+
+static inline int AcceptOne(int fd, struct sockaddr_storage *address,
+                            socklen_t *len) {
+  int peer_fd;
+
+  // accept4 sets the flags in the same call; older kernels lack it.
+#if defined(__linux__) && defined(SOCK_NONBLOCK) && defined(SOCK_CLOEXEC)
+  peer_fd = accept4(fd, (struct sockaddr*) address, len,
+                    SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (peer_fd >= 0 || errno != ENOSYS) return peer_fd;
+#endif
+
+  peer_fd = accept(fd, (struct sockaddr*) address, len);
+  if (peer_fd >= 0 && !SetSockFlags(peer_fd)) {
+    int fcntl_errno = errno;
+    close(peer_fd);
+    errno = fcntl_errno;
+    return -1;
+  }
+  return peer_fd;
+}
+
+
+//  var count = t.acceptMany(fd, peers);
+//
+//  Accepts as many pending connections as fit in the Int32Array peers,
+//  kPeerStride slots each. The remote address is left raw; peerAddress()
+//  turns it into a string when someone asks for it.
+//
+//  returns 0 on EAGAIN, raises an exception on all other errors unless
+//  something was accepted first
+static Handle<Value> AcceptMany(const Arguments& args) {
+  HandleScope scope;
+
+  FD_ARG(args[0])
+
+  Local<Object> peers;
+  if (!args[1]->IsObject() ||
+      !(peers = args[1]->ToObject())->HasIndexedPropertiesInExternalArrayData() ||
+      peers->GetIndexedPropertiesExternalArrayDataType() != kExternalIntArray) {
+    return ThrowException(Exception::TypeError(
+          String::New("Second argument should be an Int32Array")));
+  }
+
+  // Only whole kPeerStride records are filled in.
+  int32_t *slots =
+    static_cast<int32_t*>(peers->GetIndexedPropertiesExternalArrayData());
+  int max = peers->GetIndexedPropertiesExternalArrayDataLength() / kPeerStride;
+  if (max <= 0) {
+    return ThrowException(Exception::TypeError(
+          String::New("Second argument is too short")));
+  }
+  int count = 0;
+
+  while (count < max) {
+    struct sockaddr_storage address_storage;
+    socklen_t len = sizeof(struct sockaddr_storage);
+
+    int peer_fd = AcceptOne(fd, &address_storage, &len);
+
+    if (peer_fd < 0) {
+      if (errno == ECONNABORTED) continue;
+      if (count > 0 || errno == EAGAIN) break;
+      return ThrowException(ErrnoException(errno, "accept"));
+    }
+
+    int32_t *peer = slots + count * kPeerStride;
+    memset(peer, 0, kPeerStride * sizeof(int32_t));
+    peer[0] = peer_fd;
+
+    if (len > 0 && address_storage.ss_family == AF_INET) {
+      struct sockaddr_in *a4 = (struct sockaddr_in*) &address_storage;
+      peer[1] = ntohs(a4->sin_port);
+      peer[2] = AF_INET;
+      memcpy(peer + 3, &a4->sin_addr, sizeof(a4->sin_addr));
+    } else if (len > 0 && address_storage.ss_family == AF_INET6) {
+      struct sockaddr_in6 *a6 = (struct sockaddr_in6*) &address_storage;
+      peer[1] = ntohs(a6->sin6_port);
+      peer[2] = AF_INET6;
+      memcpy(peer + 3, &a6->sin6_addr, sizeof(a6->sin6_addr));
+    }
+
+    count++;
+  }
+
+  return scope.Close(Integer::New(count));
+}
+
+
+//  var address = t.peerAddress(family, a0, a1, a2, a3);
+//
+//  Formats the raw address that acceptMany left in slots 3 to 6.
+static Handle<Value> PeerAddress(const Arguments& args) {
+  HandleScope scope;
+
+  int family = args[0]->Int32Value();
+  int32_t raw[4];
+  for (int i = 0; i < 4; i++) {
+    raw[i] = args[i + 1]->Int32Value();
+  }
+
+  char ip[INET6_ADDRSTRLEN];
+  if ((family != AF_INET && family != AF_INET6) ||
+      !inet_ntop(family, raw, ip, INET6_ADDRSTRLEN)) {
+    return scope.Close(String::Empty());
+  }
+
+  return scope.Close(String::New(ip));
+}
+
+#endif // __POSIX__
+
+
 static Handle<Value> SocketError(const Arguments& args) {
   HandleScope scope;
 
@@ -1083,6 +1204,90 @@ static Handle<Value> Write(const Arguments& args) {
 
 #ifdef __POSIX__
 
+//  var bytesWritten = t.writev(fd, buffers, offsets, lengths);
+//
+//  Writes the given slices of each buffer, in order, with one writev(2) call
+//  per kWritevBatch slices. Stops at the first short write; the caller works
+//  out from the count where to resume.
+//
+//  returns 0 on EAGAIN or EINTR, raises an exception on all other errors
+//  unless something was written first
+
+// Enough to flush a typical write queue in one call, while keeping the
+// iovec array small enough for the stack.
+static const int kWritevBatch = IOV_MAX < 64 ? IOV_MAX : 64;
+
+static Handle<Value> Writev(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 4 ||
+      !args[1]->IsArray() || !args[2]->IsArray() || !args[3]->IsArray()) {
+    return ThrowException(Exception::TypeError(
+          String::New("Takes a file descriptor and 3 arrays")));
+  }
+
+  FD_ARG(args[0])
+
+  Local<Array> buffers = Local<Array>::Cast(args[1]);
+  Local<Array> offsets = Local<Array>::Cast(args[2]);
+  Local<Array> lengths = Local<Array>::Cast(args[3]);
+
+  uint32_t count = buffers->Length();
+  if (offsets->Length() != count || lengths->Length() != count) {
+    return ThrowException(Exception::TypeError(
+          String::New("Arrays must have the same length")));
+  }
+
+  struct iovec iov[kWritevBatch];
+  size_t total = 0;
+  uint32_t i = 0;
+
+  while (i < count) {
+    int iovcnt = 0;
+    size_t batch = 0;
+
+    for (; i < count && iovcnt < kWritevBatch; i++) {
+      Local<Value> buffer_v = buffers->Get(i);
+      if (!Buffer::HasInstance(buffer_v)) {
+        return ThrowException(Exception::TypeError(
+              String::New("Expected an array of buffers")));
+      }
+
+      Local<Object> buffer_obj = buffer_v->ToObject();
+      char *buffer_data = Buffer::Data(buffer_obj);
+      size_t buffer_length = Buffer::Length(buffer_obj);
+
+      size_t off = offsets->Get(i)->Uint32Value();
+      size_t len = lengths->Get(i)->Uint32Value();
+      if (off > buffer_length || len > buffer_length - off) {
+        return ThrowException(Exception::Error(
+              String::New("Length extends beyond buffer")));
+      }
+      if (len == 0) continue;
+
+      iov[iovcnt].iov_base = buffer_data + off;
+      iov[iovcnt].iov_len = len;
+      iovcnt++;
+      batch += len;
+    }
+
+    if (iovcnt == 0) break;
+
+    ssize_t written = writev(fd, iov, iovcnt);
+
+    if (written < 0) {
+      if (total > 0 || errno == EAGAIN || errno == EINTR) break;
+      return ThrowException(ErrnoException(errno, "writev"));
+    }
+
+    total += written;
+    if ((size_t) written < batch) break;
+  }
+
+  return scope.Close(Integer::NewFromUnsigned(total));
+}
+
+
 // var bytes = sendmsg(fd, buf, off, len, fd, flags);
 //
 // Write a buffer with optional offset and length to the given file
@@ -1437,6 +1642,29 @@ static Handle<Value> SetBroadcast(const Arguments& args) {
   return Undefined();
 }
 
+// Lets several processes bind their own listening socket to the same
+// address; the kernel then spreads incoming connections across them.  Has to
+// be set before bind().
+static Handle<Value> SetReusePort(const Arguments& args) {
+  HandleScope scope;
+
+  FD_ARG(args[0])
+
+#ifdef SO_REUSEPORT
+  int flags = args[1]->IsFalse() ? 0 : 1;
+
+  if (0 > setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (void *)&flags,
+      sizeof(flags))) {
+    return ThrowException(ErrnoException(errno, "setsockopt"));
+  }
+#else
+  return ThrowException(Exception::Error(
+        String::New("SO_REUSEPORT is not supported on this platform")));
+#endif
+
+  return Undefined();
+}
+
 static Handle<Value> SetTTL(const Arguments& args) {
   HandleScope scope;
 
@@ -1793,6 +2021,7 @@ void InitNet(Handle<Object> target) {
   NODE_SET_METHOD(target, "recvfrom", RecvFrom);
 
 #ifdef __POSIX__
+  NODE_SET_METHOD(target, "writev", Writev);
   NODE_SET_METHOD(target, "sendMsg", SendMsg);
 
   recv_msg_template =
@@ -1813,10 +2042,16 @@ void InitNet(Handle<Object> target) {
   NODE_SET_METHOD(target, "bind", Bind);
   NODE_SET_METHOD(target, "listen", Listen);
   NODE_SET_METHOD(target, "accept", Accept);
+#ifdef __POSIX__
+  NODE_SET_METHOD(target, "acceptMany", AcceptMany);
+  NODE_SET_METHOD(target, "peerAddress", PeerAddress);
+  target->Set(String::NewSymbol("peerStride"), Integer::New(kPeerStride));
+#endif // __POSIX__
   NODE_SET_METHOD(target, "socketError", SocketError);
   NODE_SET_METHOD(target, "toRead", ToRead);
   NODE_SET_METHOD(target, "setNoDelay", SetNoDelay);
   NODE_SET_METHOD(target, "setBroadcast", SetBroadcast);
+  NODE_SET_METHOD(target, "setReusePort", SetReusePort);
   NODE_SET_METHOD(target, "setTTL", SetTTL);
   NODE_SET_METHOD(target, "setKeepAlive", SetKeepAlive);
 #ifdef __POSIX__
@@ -21,7 +21,18 @@
 
 #include <node.h>
 #include <node_script.h>
+#include <node_javascript.h>
+#include <node_version.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h> /* PATH_MAX */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
 
 namespace node {
 
@@ -41,6 +52,9 @@ using v8::Array;
 using v8::Persistent;
 using v8::Integer;
 using v8::FunctionTemplate;
+using v8::ScriptData;
+using v8::ScriptOrigin;
+using v8::Undefined;
 
 
 class WrappedContext : ObjectWrap {
@@ -70,7 +84,8 @@ class WrappedScript : ObjectWrap {
   static void Initialize(Handle<Object> target);
 
   enum EvalInputFlags { compileCode, unwrapExternal };
-  enum EvalContextFlags { thisContext, newContext, userContext };
+  enum EvalContextFlags { thisContext, newContext, userContext,
+                          sandboxContext };
   enum EvalOutputFlags { returnResult, wrapExternal };
 
   template <EvalInputFlags input_flag,
@@ -89,9 +104,11 @@ class WrappedScript : ObjectWrap {
   static Handle<Value> RunInContext(const Arguments& args);
   static Handle<Value> RunInThisContext(const Arguments& args);
   static Handle<Value> RunInNewContext(const Arguments& args);
+  static Handle<Value> RunInSandbox(const Arguments& args);
   static Handle<Value> CompileRunInContext(const Arguments& args);
   static Handle<Value> CompileRunInThisContext(const Arguments& args);
   static Handle<Value> CompileRunInNewContext(const Arguments& args);
+  static Handle<Value> CompileRunInSandbox(const Arguments& args);
 
   Persistent<Script> script_;
 };
@@ -168,6 +185,10 @@ void WrappedScript::Initialize(Handle<Object> target) {
                             "runInNewContext",
                             WrappedScript::RunInNewContext);
 
+  NODE_SET_PROTOTYPE_METHOD(constructor_template,
+                            "runInSandbox",
+                            WrappedScript::RunInSandbox);
+
   NODE_SET_METHOD(constructor_template,
                   "createContext",
                   WrappedScript::CreateContext);
@@ -184,6 +205,10 @@ void WrappedScript::Initialize(Handle<Object> target) {
                   "runInNewContext",
                   WrappedScript::CompileRunInNewContext);
 
+  NODE_SET_METHOD(constructor_template,
+                  "runInSandbox",
+                  WrappedScript::CompileRunInSandbox);
+
   target->Set(String::NewSymbol("Script"),
               constructor_template->GetFunction());
 }
@@ -248,6 +273,13 @@ Handle<Value> WrappedScript::RunInNewContext(const Arguments& args) {
 }
 
 
+Handle<Value> WrappedScript::RunInSandbox(const Arguments& args) {
+  return
+    WrappedScript::EvalMachine<unwrapExternal, sandboxContext, returnResult>(
+        args);
+}
+
+
 Handle<Value> WrappedScript::CompileRunInContext(const Arguments& args) {
   return
     WrappedScript::EvalMachine<compileCode, userContext, returnResult>(args);
@@ -266,6 +298,319 @@ Handle<Value> WrappedScript::CompileRunInNewContext(const Arguments& args) {
 }
 
 
+Handle<Value> WrappedScript::CompileRunInSandbox(const Arguments& args) {
+  return
+    WrappedScript::EvalMachine<compileCode, sandboxContext, returnResult>(
+        args);
+}
+
+
+// Opt-in compile cache.  When NODE_COMPILE_CACHE names a directory, every
+// script compiled from a file is stored there in serialized form, and later
+// processes load it instead of parsing the source again.  An entry is only
+// used if the file's path and mtime, the source text and the engine build
+// all match, and its payload checksum is intact; anything else is treated as
+// a miss and overwritten.
+static const uint32_t kCompileCacheMagic = 0x4e4a5343;  // "NJSC"
+
+struct CompileCacheHeader {
+  uint32_t magic;
+  uint32_t header_size;
+  uint64_t build_id;
+  uint64_t mtime;
+  uint64_t source_hash;
+  uint32_t source_length;
+  uint32_t path_length;
+  uint32_t payload_length;
+  uint32_t reserved;
+  uint64_t payload_hash;
+};
+
+
+static uint64_t Fnv1a(const void* data, size_t length,
+                      uint64_t hash = 14695981039346656037ULL) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ p[i]) * 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+static uint64_t SourceHash(const String::Value& chars) {
+  return Fnv1a(*chars, chars.length() * sizeof(uint16_t));
+}
+
+
+ScriptData* LoadNativeSnapshot(Handle<String> filename,
+                               Handle<String> source) {
+  if (natives_snapshot_bytecode_version != JSXDR_BYTECODE_VERSION ||
+      !natives_snapshot[0].filename) {
+    return NULL;
+  }
+
+  String::Utf8Value name(filename);
+  if (!*name) return NULL;
+  for (const NativeSnapshot* entry = natives_snapshot; entry->filename;
+       entry++) {
+    if (strcmp(entry->filename, *name) != 0) continue;
+
+    // Anything but the exact source the snapshot was built from, such as a
+    // user script that happens to be called "fs.js", is compiled normally.
+    if (static_cast<uint32_t>(source->Length()) != entry->source_length ||
+        SourceHash(String::Value(source)) != entry->source_hash) {
+      return NULL;
+    }
+    ScriptData* data =
+        ScriptData::New(reinterpret_cast<const char*>(entry->data),
+                        entry->length);
+    if (data && data->HasError()) {
+      delete data;
+      data = NULL;
+    }
+    return data;
+  }
+  return NULL;
+}
+
+
+#ifdef NODE_MKSNAPSHOT
+// writeNativesSnapshot(path, filenames, sources) compiles each source, plus
+// src/node.js, and writes the results as a C++ table for the build to link
+// in.  Only tools/natives_snapshot.js calls this, so only node_mksnapshot
+// has it.
+static Handle<Value> WriteNativesSnapshot(const Arguments& args) {
+  HandleScope scope;
+
+  if (args.Length() < 3 || !args[1]->IsArray() || !args[2]->IsArray()) {
+    return ThrowException(Exception::TypeError(
+          String::New("needs a path, filenames and sources.")));
+  }
+  String::Utf8Value path(args[0]);
+  Local<Array> filenames = Local<Array>::Cast(args[1]);
+  Local<Array> sources = Local<Array>::Cast(args[2]);
+
+  FILE* out = fopen(*path, "w");
+  if (!out) {
+    return ThrowException(ErrnoException(errno, "fopen", "", *path));
+  }
+  fprintf(out,
+          "// Generated by tools/natives_snapshot.js.  Do not edit.\n\n"
+          "#include <node_script.h>\n\n"
+          "namespace node {\n\n");
+
+  uint32_t count = filenames->Length() + 1;
+  TryCatch try_catch;
+  for (uint32_t i = 0; i < count; i++) {
+    HandleScope inner;
+    Local<String> filename, source;
+    if (i + 1 < count) {
+      filename = filenames->Get(i)->ToString();
+      source = sources->Get(i)->ToString();
+    } else {
+      filename = String::New("node.js");
+      source = MainSource()->ToString();
+    }
+    ScriptOrigin origin(filename);
+    Local<Script> script = Script::New(source, &origin);
+    if (script.IsEmpty()) {
+      fclose(out);
+      unlink(*path);
+      return try_catch.ReThrow();
+    }
+    ScriptData* data = ScriptData::New(script);
+    if (!data || data->HasError() || data->Length() <= 0) {
+      delete data;
+      fclose(out);
+      unlink(*path);
+      return ThrowException(Exception::Error(
+            String::New("unable to serialize a builtin")));
+    }
+
+    const unsigned char* bytes =
+        reinterpret_cast<const unsigned char*>(data->Data());
+    fprintf(out, "static const unsigned char snapshot_%u[] = {", i);
+    for (int j = 0; j < data->Length(); j++) {
+      fprintf(out, "%s%u,", j % 20 ? "" : "\n  ", bytes[j]);
+    }
+    fprintf(out, "\n};\n\n");
+    delete data;
+  }
+
+  fprintf(out, "const NativeSnapshot natives_snapshot[] = {\n");
+  for (uint32_t i = 0; i < count; i++) {
+    HandleScope inner;
+    Local<String> filename, source;
+    if (i + 1 < count) {
+      filename = filenames->Get(i)->ToString();
+      source = sources->Get(i)->ToString();
+    } else {
+      filename = String::New("node.js");
+      source = MainSource()->ToString();
+    }
+    String::Utf8Value name(filename);
+    fprintf(out, "  { \"%s\", 0x%016llxULL, %d, snapshot_%u,"
+                 " sizeof(snapshot_%u) },\n",
+            *name,
+            static_cast<unsigned long long>(SourceHash(String::Value(source))),
+            source->Length(), i, i);
+  }
+  fprintf(out, "  { NULL, 0, 0, NULL, 0 }\n"
+               "};\n\n"
+               "const uint32_t natives_snapshot_bytecode_version = %uU;\n\n"
+               "}  // namespace node\n",
+          static_cast<unsigned>(JSXDR_BYTECODE_VERSION));
+
+  if (fclose(out) != 0) {
+    unlink(*path);
+    return ThrowException(ErrnoException(errno, "fclose", "", *path));
+  }
+  return Undefined();
+}
+#endif  // NODE_MKSNAPSHOT
+
+
+// Identifies the node binary and the engine's bytecode format, so blobs
+// written by another build are never decoded.
+static uint64_t CompileCacheBuildId() {
+  static const char build[] = NODE_VERSION " " __DATE__ " " __TIME__;
+  uint32_t bytecode = JSXDR_BYTECODE_VERSION;
+  return Fnv1a(build, sizeof(build) - 1, Fnv1a(&bytecode, sizeof(bytecode)));
+}
+
+
+static const char* CompileCacheDir() {
+  static bool initialized = false;
+  static const char* dir = NULL;
+  if (!initialized) {
+    initialized = true;
+    dir = getenv("NODE_COMPILE_CACHE");
+    if (dir && !*dir) dir = NULL;
+  }
+  return dir;
+}
+
+
+// Everything that decides whether a cache entry belongs to a script.
+class CompileCacheKey {
+ public:
+  CompileCacheKey(Handle<String> filename, Handle<String> source)
+      : path_(CompileCacheDir() ? filename : Handle<String>()),
+        valid_(false) {
+    const char* dir = CompileCacheDir();
+    struct stat st;
+    if (!dir || !*path_ || stat(*path_, &st) != 0 || !S_ISREG(st.st_mode)) {
+      return;
+    }
+    String::Value chars(source);
+    memset(&header_, 0, sizeof(header_));
+    header_.magic = kCompileCacheMagic;
+    header_.header_size = sizeof(header_);
+    header_.build_id = CompileCacheBuildId();
+    header_.mtime = static_cast<uint64_t>(st.st_mtime);
+    header_.source_hash = SourceHash(chars);
+    header_.source_length = chars.length();
+    header_.path_length = path_.length();
+
+    snprintf(file_, sizeof(file_), "%s/%016llx.jsc", dir,
+             static_cast<unsigned long long>(Fnv1a(*path_, path_.length())));
+    valid_ = true;
+  }
+
+  bool valid() const { return valid_; }
+
+  // Returns the cached script, or NULL on any kind of miss.
+  ScriptData* Load() {
+    int fd = open(file_, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    ScriptData* data = NULL;
+    CompileCacheHeader header;
+    char* buf = NULL;
+    if (ReadFully(fd, &header, sizeof(header)) &&
+        header.magic == header_.magic &&
+        header.header_size == header_.header_size &&
+        header.build_id == header_.build_id &&
+        header.mtime == header_.mtime &&
+        header.source_hash == header_.source_hash &&
+        header.source_length == header_.source_length &&
+        header.path_length == header_.path_length) {
+      size_t length = header.path_length + header.payload_length;
+      buf = static_cast<char*>(malloc(length));
+      if (buf && ReadFully(fd, buf, length) &&
+          memcmp(buf, *path_, header.path_length) == 0) {
+        const char* payload = buf + header.path_length;
+        if (Fnv1a(payload, header.payload_length) == header.payload_hash) {
+          data = ScriptData::New(payload, header.payload_length);
+          if (data && data->HasError()) {
+            delete data;
+            data = NULL;
+          }
+        }
+      }
+    }
+    free(buf);
+    close(fd);
+    return data;
+  }
+
+  // Writes to a temporary file and renames it into place, so concurrent
+  // processes never see a partial entry.  Failures are ignored.
+  void Store(Handle<Script> script) {
+    ScriptData* data = ScriptData::New(script);
+    if (!data) return;
+    if (!data->HasError() && data->Length() > 0) {
+      CompileCacheHeader header = header_;
+      header.payload_length = data->Length();
+      header.payload_hash = Fnv1a(data->Data(), data->Length());
+
+      char tmp[sizeof(file_) + 32];
+      snprintf(tmp, sizeof(tmp), "%s.%d.tmp", file_,
+               static_cast<int>(getpid()));
+      int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd >= 0) {
+        bool ok = WriteFully(fd, &header, sizeof(header)) &&
+                  WriteFully(fd, *path_, header.path_length) &&
+                  WriteFully(fd, data->Data(), header.payload_length);
+        close(fd);
+        if (!ok || rename(tmp, file_) != 0) unlink(tmp);
+      }
+    }
+    delete data;
+  }
+
+ private:
+  static bool ReadFully(int fd, void* buf, size_t length) {
+    char* p = static_cast<char*>(buf);
+    while (length > 0) {
+      ssize_t r = read(fd, p, length);
+      if (r < 0 && errno == EINTR) continue;
+      if (r <= 0) return false;
+      p += r;
+      length -= r;
+    }
+    return true;
+  }
+
+  static bool WriteFully(int fd, const void* buf, size_t length) {
+    const char* p = static_cast<const char*>(buf);
+    while (length > 0) {
+      ssize_t r = write(fd, p, length);
+      if (r < 0 && errno == EINTR) continue;
+      if (r <= 0) return false;
+      p += r;
+      length -= r;
+    }
+    return true;
+  }
+
+  String::Utf8Value path_;
+  CompileCacheHeader header_;
+  char file_[PATH_MAX];
+  bool valid_;
+};
+
+
 template <WrappedScript::EvalInputFlags input_flag,
           WrappedScript::EvalContextFlags context_flag,
           WrappedScript::EvalOutputFlags output_flag>
@@ -287,8 +632,11 @@ Handle<Value> WrappedScript::EvalMachine(const Arguments& args) {
   Local<String> code;
   if (input_flag == compileCode) code = args[0]->ToString();
 
+  const bool fresh_context = context_flag == newContext ||
+                             context_flag == sandboxContext;
+
   Local<Object> sandbox;
-  if (context_flag == newContext) {
+  if (fresh_context) {
     sandbox = args[sandbox_index]->IsObject() ? args[sandbox_index]->ToObject()
                                               : Object::New();
   } else if (context_flag == userContext) {
@@ -296,7 +644,7 @@ Handle<Value> WrappedScript::EvalMachine(const Arguments& args) {
   }
 
   const int filename_index = sandbox_index +
-                             (context_flag == newContext ? 1 : 0);
+                             (fresh_context ? 1 : 0);
   Local<String> filename = args.Length() > filename_index
                            ? args[filename_index]->ToString()
                            : String::New("evalmachine.<anonymous>");
@@ -313,7 +661,7 @@ Handle<Value> WrappedScript::EvalMachine(const Arguments& args) {
 
   Local<Array> keys;
   unsigned int i;
-  if (context_flag == newContext) {
+  if (fresh_context) {
     // Create the new context
     context = Context::New();
 
@@ -324,6 +672,14 @@ Handle<Value> WrappedScript::EvalMachine(const Arguments& args) {
     context = nContext->GetV8Context();
   }
 
+  if (context_flag == sandboxContext) {
+    // Proxy the sandbox instead of copying it in: the new global inherits
+    // from it, so reads see the sandbox as it is, and assignments land on the
+    // global to be copied back below.
+    context->Enter();
+    context->Global()->SetPrototype(sandbox);
+  }
+
   // New and user context share code. DRY it up.
   if (context_flag == userContext || context_flag == newContext) {
     // Enter the context
@@ -348,10 +704,21 @@ Handle<Value> WrappedScript::EvalMachine(const Arguments& args) {
   Handle<Script> script;
 
   if (input_flag == compileCode) {
+    CompileCacheKey cache_key(filename, code);
+    ScriptData* cached = LoadNativeSnapshot(filename, code);
+    if (!cached && cache_key.valid()) cached = cache_key.Load();
+
     // well, here WrappedScript::New would suffice in all cases, but maybe
     // Compile has a little better performance where possible
-    script = output_flag == returnResult ? Script::Compile(code, filename)
-                                         : Script::New(code, filename);
+    ScriptOrigin origin(filename);
+    script = output_flag == returnResult
+             ? Script::Compile(code, &origin, cached)
+             : Script::New(code, &origin, cached);
+    if (cached) {
+      delete cached;
+    } else if (cache_key.valid() && !script.IsEmpty()) {
+      cache_key.Store(script);
+    }
     if (script.IsEmpty()) {
       // FIXME UGLY HACK TO DISPLAY SYNTAX ERRORS.
       if (display_error) DisplayExceptionLine(try_catch);
@@ -377,7 +744,7 @@ Handle<Value> WrappedScript::EvalMachine(const Arguments& args) {
   if (output_flag == returnResult) {
     result = script->Run();
     if (result.IsEmpty()) {
-      if (context_flag == newContext) {
+      if (fresh_context) {
         context->DetachGlobal();
         context->Exit();
         context.Dispose();
@@ -394,7 +761,7 @@ Handle<Value> WrappedScript::EvalMachine(const Arguments& args) {
     result = args.This();
   }
 
-  if (context_flag == userContext || context_flag == newContext) {
+  if (context_flag != thisContext) {
     // success! copy changes back onto the sandbox object.
     keys = context->Global()->GetPropertyNames();
     for (i = 0; i < keys->Length(); i++) {
@@ -405,7 +772,7 @@ Handle<Value> WrappedScript::EvalMachine(const Arguments& args) {
     }
   }
 
-  if (context_flag == newContext) {
+  if (fresh_context) {
     // Clean up, clean up, everybody everywhere!
     context->DetachGlobal();
     context->Exit();
@@ -424,6 +791,10 @@ void InitEvals(Handle<Object> target) {
 
   WrappedContext::Initialize(target);
   WrappedScript::Initialize(target);
+
+#ifdef NODE_MKSNAPSHOT
+  NODE_SET_METHOD(target, "writeNativesSnapshot", WriteNativesSnapshot);
+#endif
 }
 
 
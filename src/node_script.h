@@ -32,5 +32,24 @@ namespace node {
 
 void InitEvals(v8::Handle<v8::Object> target);
 
+// A builtin compiled at build time by tools/natives_snapshot.js.  The table
+// ends with an entry whose filename is NULL; builds without a snapshot link
+// src/node_natives_snapshot_empty.cc instead.
+struct NativeSnapshot {
+  const char* filename;
+  uint64_t source_hash;
+  uint32_t source_length;
+  const unsigned char* data;
+  uint32_t length;
+};
+
+extern const NativeSnapshot natives_snapshot[];
+extern const uint32_t natives_snapshot_bytecode_version;
+
+// Returns the snapshotted script for filename if it was compiled from
+// exactly this source by this engine, and NULL otherwise.
+v8::ScriptData* LoadNativeSnapshot(v8::Handle<v8::String> filename,
+                                   v8::Handle<v8::String> source);
+
 } // namespace node
 #endif //  node_script_h
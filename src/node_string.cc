@@ -36,4 +36,15 @@ Handle<String> ImmutableAsciiSource::CreateFromLiteral(
   return scope.Close(ret);
 }
 
+Handle<String> ImmutableTwoByteSource::CreateFromLiteral(
+    const uint16_t *src,
+    size_t length) {
+  HandleScope scope;
+
+  Local<String> ret = String::NewExternal(new ImmutableTwoByteSource(
+      src,
+      length));
+  return scope.Close(ret);
+}
+
 }
@@ -31,6 +31,8 @@ namespace node {
       string_literal "", sizeof(string_literal) - 1)
 #define BUILTIN_ASCII_ARRAY(array, len)                                 \
   ::node::ImmutableAsciiSource::CreateFromLiteral(array, len)
+#define BUILTIN_TWO_BYTE_ARRAY(array, len)                              \
+  ::node::ImmutableTwoByteSource::CreateFromLiteral(array, len)
 
 class ImmutableAsciiSource : public v8::String::ExternalAsciiStringResource {
  public:
@@ -58,6 +60,38 @@ class ImmutableAsciiSource : public v8::String::ExternalAsciiStringResource {
   size_t buf_len_;
 };
 
+// The array must be NUL-terminated and outlive the process, which holds for
+// the js2c-generated sources.
+class ImmutableTwoByteSource : public v8::String::ExternalStringResource {
+ public:
+  static v8::Handle<v8::String> CreateFromLiteral(const uint16_t *src,
+                                                  size_t length);
+
+  ImmutableTwoByteSource(const uint16_t *src, size_t src_len)
+      : buffer_(src),
+        buf_len_(src_len) {
+  }
+
+  ~ImmutableTwoByteSource() {
+  }
+
+  const uint16_t *data() const {
+      return buffer_;
+  }
+
+  size_t length() const {
+      return buf_len_;
+  }
+
+  bool IsTerminated() const {
+      return true;
+  }
+
+ private:
+  const uint16_t *buffer_;
+  size_t buf_len_;
+};
+
 }  // namespace node
 
 #endif  // SRC_NODE_STRING_H_
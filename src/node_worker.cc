@@ -0,0 +1,414 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#include <node_worker.h>
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace node {
+
+using namespace v8;
+
+Persistent<FunctionTemplate> Worker::constructor_template;
+static Persistent<String> onmessage_symbol;
+static Persistent<String> onerror_symbol;
+static Persistent<String> onexit_symbol;
+
+void Worker::Initialize(Handle<Object> target) {
+  HandleScope scope;
+
+  Local<FunctionTemplate> t = FunctionTemplate::New(Worker::New);
+  constructor_template = Persistent<FunctionTemplate>::New(t);
+  constructor_template->InstanceTemplate()->SetInternalFieldCount(1);
+  constructor_template->SetClassName(String::NewSymbol("Worker"));
+
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "postMessage", Worker::PostMessage);
+  NODE_SET_PROTOTYPE_METHOD(constructor_template, "terminate", Worker::Terminate);
+
+  target->Set(String::NewSymbol("Worker"),
+      constructor_template->GetFunction());
+
+  onmessage_symbol = NODE_PSYMBOL("onmessage");
+  onerror_symbol = NODE_PSYMBOL("onerror");
+  onexit_symbol = NODE_PSYMBOL("onexit");
+}
+
+
+void Worker::Queue::Push(Message *m) {
+  m->next = NULL;
+  if (tail) {
+    tail->next = m;
+  } else {
+    head = m;
+  }
+  tail = m;
+}
+
+
+Worker::Message *Worker::Queue::Take() {
+  Message *m = head;
+  head = tail = NULL;
+  return m;
+}
+
+
+void Worker::Queue::Free(Message *m) {
+  while (m) {
+    Message *next = m->next;
+    delete m;
+    m = next;
+  }
+}
+
+
+Worker::Worker(const char *source, const char *filename) : ObjectWrap() {
+  source_ = strdup(source);
+  filename_ = strdup(filename);
+  pthread_mutex_init(&mutex_, NULL);
+  terminate_ = false;
+  closed_ = false;
+  exited_ = false;
+  closing_ = false;
+
+  // Starting an async watcher clears anything already sent to it, so the
+  // worker's is started here, before its thread exists.
+  loop_ = ev_loop_new(EVFLAG_AUTO);
+  if (loop_) {
+    ev_async_init(&worker_watcher_, Worker::OnWorkerMessages);
+    worker_watcher_.data = this;
+    ev_async_start(loop_, &worker_watcher_);
+  }
+
+  ev_async_init(&parent_watcher_, Worker::OnParentMessages);
+  parent_watcher_.data = this;
+}
+
+
+Worker::~Worker() {
+  assert(!ev_is_active(&parent_watcher_));
+  if (loop_) ev_loop_destroy(loop_);
+  Queue::Free(toWorker_.Take());
+  Queue::Free(toParent_.Take());
+  pthread_mutex_destroy(&mutex_);
+  free(source_);
+  free(filename_);
+}
+
+
+Handle<Value> Worker::New(const Arguments& args) {
+  if (!args.IsConstructCall()) {
+    return FromConstructorTemplate(constructor_template, args);
+  }
+
+  HandleScope scope;
+
+  if (args.Length() < 2 || !args[0]->IsString() || !args[1]->IsString()) {
+    return ThrowException(Exception::TypeError(
+          String::New("Bad arguments")));
+  }
+
+  String::Utf8Value source(args[0]);
+  String::Utf8Value filename(args[1]);
+  Worker *w = new Worker(*source, *filename);
+  w->Wrap(args.Holder());
+
+  if (!w->loop_) {
+    return ThrowException(ErrnoException(errno, "ev_loop_new"));
+  }
+
+  // Likewise the parent's watcher has to be running before the worker can
+  // post.  A running worker keeps the process alive, like a child process
+  // does.
+  ev_async_start(EV_DEFAULT_UC_ &w->parent_watcher_);
+  int r = pthread_create(&w->thread_, NULL, Worker::Run, w);
+  if (r != 0) {
+    ev_async_stop(EV_DEFAULT_UC_ &w->parent_watcher_);
+    return ThrowException(ErrnoException(r, "pthread_create"));
+  }
+  w->Ref();
+
+  return args.This();
+}
+
+
+Handle<Value> Worker::PostMessage(const Arguments& args) {
+  HandleScope scope;
+  Worker *w = ObjectWrap::Unwrap<Worker>(args.Holder());
+
+  Message *m = new Message;
+  m->error = false;
+  if (!m->data.Write(args[0])) {
+    delete m;
+    return ThrowException(Exception::TypeError(
+          String::New("Message could not be cloned")));
+  }
+  w->Post(m, true);
+
+  return Undefined();
+}
+
+
+Handle<Value> Worker::Terminate(const Arguments& args) {
+  HandleScope scope;
+  Worker *w = ObjectWrap::Unwrap<Worker>(args.Holder());
+
+  pthread_mutex_lock(&w->mutex_);
+  if (!w->closed_) {
+    w->terminate_ = true;
+    ev_async_send(w->loop_, &w->worker_watcher_);
+  }
+  pthread_mutex_unlock(&w->mutex_);
+
+  return Undefined();
+}
+
+
+// Messages to a worker that has closed are dropped.
+void Worker::Post(Message *m, bool toWorker) {
+  pthread_mutex_lock(&mutex_);
+  if (toWorker) {
+    if (closed_) {
+      delete m;
+    } else {
+      toWorker_.Push(m);
+      ev_async_send(loop_, &worker_watcher_);
+    }
+  } else {
+    toParent_.Push(m);
+    ev_async_send(EV_DEFAULT_UC_ &parent_watcher_);
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+
+void Worker::OnParentMessages(EV_P_ ev_async *watcher, int revents) {
+  Worker *w = static_cast<Worker*>(watcher->data);
+
+  assert(watcher == &w->parent_watcher_);
+  assert(revents == EV_ASYNC);
+
+  // Everything the worker posted is queued before it is marked as exited.
+  pthread_mutex_lock(&w->mutex_);
+  Message *messages = w->toParent_.Take();
+  bool exited = w->exited_;
+  pthread_mutex_unlock(&w->mutex_);
+
+  HandleScope scope;
+
+  while (messages) {
+    Message *m = messages;
+    messages = m->next;
+
+    Local<Value> callback_v =
+      w->handle_->Get(m->error ? onerror_symbol : onmessage_symbol);
+    Local<Value> data = m->data.Read();
+    delete m;
+    if (!callback_v->IsFunction() || data.IsEmpty()) continue;
+
+    Local<Function> callback = Local<Function>::Cast(callback_v);
+    Local<Value> argv[1] = { data };
+
+    TryCatch try_catch;
+
+    callback->Call(w->handle_, 1, argv);
+
+    if (try_catch.HasCaught()) {
+      FatalException(try_catch);
+    }
+  }
+
+  if (!exited) return;
+
+  pthread_join(w->thread_, NULL);
+  ev_async_stop(EV_DEFAULT_UC_ &w->parent_watcher_);
+
+  Local<Value> callback_v = w->handle_->Get(onexit_symbol);
+  if (callback_v->IsFunction()) {
+    Local<Function> callback = Local<Function>::Cast(callback_v);
+
+    TryCatch try_catch;
+
+    callback->Call(w->handle_, 0, NULL);
+
+    if (try_catch.HasCaught()) {
+      FatalException(try_catch);
+    }
+  }
+
+  w->Unref();
+}
+
+
+// Everything below runs on the worker's thread.
+
+void *Worker::Run(void *arg) {
+  Worker *w = static_cast<Worker*>(arg);
+
+  Isolate *isolate = Isolate::New();
+  isolate->SetData(w);
+  {
+    Isolate::Scope isolate_scope(isolate);
+    w->RunScript();
+  }
+  isolate->Dispose();
+
+  pthread_mutex_lock(&w->mutex_);
+  w->closed_ = true;
+  ev_loop_destroy(w->loop_);
+  w->loop_ = NULL;
+  w->exited_ = true;
+  ev_async_send(EV_DEFAULT_UC_ &w->parent_watcher_);
+  pthread_mutex_unlock(&w->mutex_);
+
+  return NULL;
+}
+
+
+void Worker::RunScript() {
+  HandleScope scope;
+
+  Persistent<Context> context = Context::New();
+  Context::Scope context_scope(context);
+
+  Local<Object> global = context->Global();
+  global->Set(String::NewSymbol("postMessage"),
+      FunctionTemplate::New(Worker::WorkerPostMessage)->GetFunction());
+  global->Set(String::NewSymbol("close"),
+      FunctionTemplate::New(Worker::WorkerClose)->GetFunction());
+
+  {
+    TryCatch try_catch;
+    Local<Script> script = Script::Compile(String::New(source_),
+                                           String::New(filename_));
+    if (!script.IsEmpty()) {
+      script->Run();
+    }
+    if (try_catch.HasCaught()) {
+      PostError(try_catch);
+    }
+  }
+
+  // The loop only ends through close() or terminate(), since the watcher
+  // for incoming messages is always active.
+  if (!closing_) {
+    ev_loop(loop_, 0);
+  }
+
+  context.Dispose();
+}
+
+
+void Worker::Close() {
+  closing_ = true;
+  ev_unloop(loop_, EVUNLOOP_ALL);
+}
+
+
+void Worker::PostError(TryCatch &try_catch) {
+  HandleScope scope;
+
+  // Only the description crosses over; the error object itself belongs to
+  // this isolate.
+  Local<Value> description = try_catch.Exception()->ToString();
+
+  Message *m = new Message;
+  m->error = true;
+  if (description.IsEmpty() || !m->data.Write(description)) {
+    delete m;
+    return;
+  }
+  Post(m, false);
+}
+
+
+void Worker::OnWorkerMessages(EV_P_ ev_async *watcher, int revents) {
+  Worker *w = static_cast<Worker*>(watcher->data);
+
+  assert(watcher == &w->worker_watcher_);
+  assert(revents == EV_ASYNC);
+
+  pthread_mutex_lock(&w->mutex_);
+  Message *messages = w->toWorker_.Take();
+  bool terminate = w->terminate_;
+  pthread_mutex_unlock(&w->mutex_);
+
+  if (terminate) {
+    Queue::Free(messages);
+    w->Close();
+    return;
+  }
+
+  HandleScope scope;
+  Local<Object> global = Context::GetCurrent()->Global();
+
+  while (messages) {
+    Message *m = messages;
+    messages = m->next;
+
+    // Messages that arrive after close() are dropped.  The symbols above
+    // belong to the parent's isolate.
+    Local<Value> callback_v = global->Get(String::NewSymbol("onmessage"));
+    Local<Value> data = w->closing_ ? Local<Value>() : m->data.Read();
+    delete m;
+    if (!callback_v->IsFunction() || data.IsEmpty()) continue;
+
+    Local<Function> callback = Local<Function>::Cast(callback_v);
+    Local<Value> argv[1] = { data };
+
+    TryCatch try_catch;
+
+    callback->Call(global, 1, argv);
+
+    if (try_catch.HasCaught()) {
+      w->PostError(try_catch);
+    }
+  }
+}
+
+
+Handle<Value> Worker::WorkerPostMessage(const Arguments& args) {
+  HandleScope scope;
+  Worker *w = static_cast<Worker*>(Isolate::GetCurrent()->GetData());
+
+  Message *m = new Message;
+  m->error = false;
+  if (!m->data.Write(args[0])) {
+    delete m;
+    return ThrowException(Exception::TypeError(
+          String::New("Message could not be cloned")));
+  }
+  w->Post(m, false);
+
+  return Undefined();
+}
+
+
+Handle<Value> Worker::WorkerClose(const Arguments& args) {
+  Worker *w = static_cast<Worker*>(Isolate::GetCurrent()->GetData());
+  w->Close();
+  return Undefined();
+}
+
+}  // namespace node
+
+NODE_MODULE(node_worker, node::Worker::Initialize);
@@ -0,0 +1,102 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+#ifndef NODE_WORKER_H_
+#define NODE_WORKER_H_
+
+#include <node.h>
+
+#include <v8.h>
+#include <ev.h>
+#include <pthread.h>
+
+namespace node {
+
+// Runs a script on its own thread, in its own isolate and event loop.  The
+// two sides only share structured clones of the messages they post.
+class Worker : ObjectWrap {
+ public:
+  static void Initialize(v8::Handle<v8::Object> target);
+
+ protected:
+  static v8::Persistent<v8::FunctionTemplate> constructor_template;
+
+  Worker(const char *source, const char *filename);
+  ~Worker();
+
+  static v8::Handle<v8::Value> New(const v8::Arguments& args);
+  static v8::Handle<v8::Value> PostMessage(const v8::Arguments& args);
+  static v8::Handle<v8::Value> Terminate(const v8::Arguments& args);
+
+ private:
+  struct Message {
+    bool error;
+    v8::StructuredClone data;
+    Message *next;
+  };
+
+  // A queue of messages for one side, filled by the other.
+  struct Queue {
+    Message *head;
+    Message *tail;
+
+    Queue() : head(NULL), tail(NULL) {}
+    void Push(Message *m);
+    Message *Take();
+    static void Free(Message *m);
+  };
+
+  static void *Run(void *arg);
+  static void OnParentMessages(EV_P_ ev_async *watcher, int revents);
+  static void OnWorkerMessages(EV_P_ ev_async *watcher, int revents);
+
+  // Globals of the worker's context.
+  static v8::Handle<v8::Value> WorkerPostMessage(const v8::Arguments& args);
+  static v8::Handle<v8::Value> WorkerClose(const v8::Arguments& args);
+
+  void RunScript();
+  void Close();
+  void Post(Message *m, bool toWorker);
+  void PostError(v8::TryCatch &try_catch);
+
+  char *source_;
+  char *filename_;
+  pthread_t thread_;
+
+  // Guards the queues and the flags below, which both threads touch.
+  pthread_mutex_t mutex_;
+  Queue toWorker_;
+  Queue toParent_;
+  bool terminate_;
+  bool closed_;
+  bool exited_;
+
+  // Owned by the worker thread once it starts.
+  struct ev_loop *loop_;
+  ev_async worker_watcher_;
+  bool closing_;
+
+  // Lives on the parent's loop.
+  ev_async parent_watcher_;
+};
+
+}  // namespace node
+#endif  // NODE_WORKER_H_
@@ -0,0 +1,82 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Flags: --expose_gc
+
+// Allocates and drops 10 GB worth of Buffers. Their contents live outside
+// the JS heap, so unless those bytes count towards starting a collection,
+// the process runs out of memory long before the GC heap looks full.
+
+var common = require('../common');
+var assert = require('assert');
+var SlowBuffer = require('buffer').SlowBuffer;
+
+var kChunk = 1024 * 1024;
+var kTotal = 10 * 1024 * kChunk;
+var kCeiling = 256 * 1024 * 1024;
+var kSlowBuffers = 16;
+
+// SlowBuffers report their memory through
+// V8::AdjustAmountOfExternalAllocatedMemory, and give it back once they are
+// collected.
+gc();
+var externalBefore = process.memoryUsage().external;
+var slow = [];
+for (var i = 0; i < kSlowBuffers; i++) {
+  var s = new SlowBuffer(kChunk);
+  s[0] = i;
+  s[kChunk - 1] = 256 + i;
+  slow.push(s);
+}
+// Indexing reaches the native storage, with byte semantics.
+for (var i = 0; i < kSlowBuffers; i++) {
+  assert.equal(slow[i][0], i);
+  assert.equal(slow[i][kChunk - 1], i);
+  assert.equal(slow[i][kChunk], undefined);
+}
+var externalHeld = process.memoryUsage().external;
+slow = s = null;
+gc();
+var externalAfter = process.memoryUsage().external;
+
+var maxRss = 0;
+var maxExternal = 0;
+
+for (var allocated = 0; allocated < kTotal; allocated += kChunk) {
+  var b = new Buffer(kChunk);
+  // Touch every page so that the allocation really counts against rss.
+  for (var i = 0; i < kChunk; i += 4096) b[i] = 1;
+
+  if (allocated % (64 * kChunk) == 0) {
+    var usage = process.memoryUsage();
+    maxRss = Math.max(maxRss, usage.rss);
+    maxExternal = Math.max(maxExternal, usage.external);
+  }
+}
+
+process.on('exit', function() {
+  console.error('max rss: %dmb, max external: %dmb',
+                Math.round(maxRss / kChunk),
+                Math.round(maxExternal / kChunk));
+  assert.ok(externalHeld - externalBefore >= kSlowBuffers * kChunk);
+  assert.ok(externalAfter - externalBefore < kChunk);
+  assert.ok(maxRss < kCeiling);
+});
@@ -0,0 +1,73 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// The native Buffer methods reach the bytes through a slot on the proxy,
+// so they must agree with what the array holds.
+
+var common = require('../common');
+var assert = require('assert');
+var Buffer = require('buffer').Buffer;
+var SlowBuffer = require('buffer').SlowBuffer;
+
+var b = new Buffer(16);
+assert.equal(b.write('hello world', 0, 'ascii'), 11);
+assert.equal(b.toString('ascii', 0, 11), 'hello world');
+assert.equal(b[4], 'o'.charCodeAt(0));
+assert.equal(b.parent, b.parent);
+
+b.write('W', 6, 'ascii');
+assert.equal(b.toString('utf8', 0, 11), 'hello World');
+
+var c = new Buffer(5);
+assert.equal(b.copy(c, 0, 6, 11), 5);
+assert.equal(c.toString('ascii', 0, 5), 'World');
+
+// Properties stashed on a buffer don't disturb its storage.
+b.rawArray = null;
+assert.equal(b.toString('ascii', 0, 5), 'hello');
+
+assert.ok(Buffer.isBuffer(b));
+assert.ok(!Buffer.isBuffer({}));
+
+// Scripts can't point a Buffer at other storage.
+assert.equal(SlowBuffer.setRawArray, undefined);
+assert.equal(SlowBuffer.prototype.setRawArray, undefined);
+
+// The native methods check their receiver, and don't take any proxy for a
+// Buffer.
+[{}, Proxy.create({}), Object.create(SlowBuffer.prototype)].forEach(function(o) {
+  assert.throws(function() {
+    SlowBuffer.prototype.utf8Write.call(o, 'x', 0);
+  }, TypeError);
+  assert.throws(function() {
+    SlowBuffer.prototype.asciiSlice.call(o, 0, 0);
+  }, TypeError);
+  assert.throws(function() {
+    SlowBuffer.prototype.copy.call(b, o, 0, 0, 1);
+  }, TypeError);
+});
+
+// SlowBuffers made by native code are Buffers too.
+var slow = new SlowBuffer(4);
+assert.equal(slow.asciiWrite('abcd', 0), 4);
+assert.equal(slow[1], 'b'.charCodeAt(0));
+assert.equal(SlowBuffer.prototype.copy.call(b, slow, 2, 0, 2), 2);
+assert.equal(slow.asciiSlice(0, 4), 'abhe');
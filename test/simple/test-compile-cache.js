@@ -0,0 +1,124 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var exec = require('child_process').exec;
+var fs = require('fs');
+var path = require('path');
+
+var dir = path.join(common.tmpDir, 'compile-cache');
+var cacheDir = path.join(dir, 'cache');
+var moduleFile = path.join(dir, 'module.js');
+var mainFile = path.join(dir, 'main.js');
+var resultFile = path.join(dir, 'result.txt');
+
+function mkdir(d) {
+  try {
+    fs.mkdirSync(d, 0755);
+  } catch (e) {
+    if (e.code !== 'EEXIST') throw e;
+  }
+}
+
+function rmdir(d) {
+  fs.readdirSync(d).forEach(function(name) {
+    var file = path.join(d, name);
+    if (fs.statSync(file).isDirectory()) {
+      rmdir(file);
+    } else {
+      fs.unlinkSync(file);
+    }
+  });
+  fs.rmdirSync(d);
+}
+
+mkdir(common.tmpDir);
+mkdir(dir);
+mkdir(cacheDir);
+fs.readdirSync(cacheDir).forEach(function(name) {
+  fs.unlinkSync(path.join(cacheDir, name));
+});
+
+function writeModule(factor) {
+  fs.writeFileSync(moduleFile,
+                   'exports.value = 7 * ' + factor + ';\n' +
+                   'exports.where = function() {\n' +
+                   '  return new Error().stack.split("\\n")[0];\n' +
+                   '};\n');
+}
+writeModule(6);
+fs.writeFileSync(mainFile,
+                 'var m = require(' + JSON.stringify(moduleFile) + ');\n' +
+                 'require("fs").writeFileSync(' +
+                 JSON.stringify(resultFile) + ', m.value + " " + m.where());\n');
+
+var env = {};
+for (var k in process.env) env[k] = process.env[k];
+env.NODE_COMPILE_CACHE = cacheDir;
+
+// The child reports through a file and stays silent otherwise.
+function run(cb) {
+  exec(JSON.stringify(process.execPath) + ' ' + JSON.stringify(mainFile) +
+       ' >/dev/null 2>&1',
+       { env: env },
+       function(err) {
+         assert.ifError(err);
+         cb(fs.readFileSync(resultFile, 'utf8'));
+       });
+}
+
+var runs = 0;
+
+// The first run fills the cache, the second is served from it and must
+// behave identically, including file names and line numbers.
+run(function(cold) {
+  runs++;
+  assert.ok(/^42 .*module\.js:\d+$/.test(cold), cold);
+  var entries = fs.readdirSync(cacheDir);
+  assert.ok(entries.length >= 2);
+
+  run(function(warm) {
+    runs++;
+    assert.equal(warm, cold);
+
+    // Damaged entries are ignored and rewritten.
+    entries.forEach(function(name) {
+      fs.writeFileSync(path.join(cacheDir, name), 'garbage');
+    });
+    run(function(repaired) {
+      runs++;
+      assert.equal(repaired, cold);
+
+      // Changed source is compiled again.
+      writeModule(7);
+      run(function(changed) {
+        runs++;
+        assert.ok(/^49 /.test(changed), changed);
+      });
+    });
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(runs, 4);
+  rmdir(dir);
+});
@@ -0,0 +1,55 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+
+var phases = ['mark', 'sweep', 'sweepObjects', 'sweepStrings',
+              'sweepScripts', 'sweepShapes', 'discardCode', 'destroy'];
+
+function check(stats) {
+  assert.equal(typeof stats.count, 'number');
+  assert.ok(stats.maxPause <= stats.totalPause);
+  assert.ok(stats.lastPause <= stats.maxPause);
+  phases.forEach(function(phase) {
+    assert.equal(typeof stats.phases[phase], 'number');
+    assert.ok(stats.phases[phase] <= stats.totalPause);
+  });
+  assert.ok(stats.phases.mark + stats.phases.sweep <= stats.totalPause);
+  assert.equal(stats.histogram.length, 12);
+  var total = stats.histogram.reduce(function(a, b) { return a + b; }, 0);
+  assert.equal(total, stats.count);
+}
+
+var before = process.gcStats();
+check(before);
+
+// Buffers count towards the engine's malloc limit, so churning through
+// them is a quick way to get a collection.
+for (var i = 0; i < 1000 && process.gcStats().count === before.count; i++) {
+  new Buffer(1024 * 1024);
+}
+
+var after = process.gcStats();
+check(after);
+assert.ok(after.count > before.count);
+assert.ok(after.totalPause >= before.totalPause + after.lastPause);
+assert.ok(after.phases.mark > before.phases.mark);
@@ -0,0 +1,43 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+
+var usage = process.memoryUsage();
+assert.ok(usage.heapUsed > 0);
+assert.ok(usage.heapUsed <= usage.heapTotal);
+
+var strings = [];
+for (var i = 0; i < 10000; i++) strings.push('string ' + i);
+
+var breakdown = process.heapBreakdown();
+console.log(common.inspect(breakdown));
+assert.ok(Array.isArray(breakdown));
+
+var main = breakdown.filter(function(c) { return c.name == 'main'; })[0];
+assert.ok(main);
+['objects', 'strings', 'shapes', 'scripts', 'typeInference', 'mjitCode',
+ 'unused'].forEach(function(kind) {
+  assert.equal('number', typeof main[kind], kind);
+});
+assert.ok(main.strings > 10000 * 16);
+assert.ok(main.objects > 0);
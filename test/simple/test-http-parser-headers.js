@@ -0,0 +1,131 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Without onURL/onHeaderField/onHeaderValue callbacks the parser collects
+// the URL and headers itself, whichever way the message is cut up.  Header
+// names come out lowercased, each followed by its value and how a repeat of
+// it is handled.
+
+var common = require('../common');
+var assert = require('assert');
+
+var binding = process.binding('http_parser');
+var HTTPParser = binding.HTTPParser;
+var FIRST = binding.HEADER_FIRST;
+var JOIN = binding.HEADER_JOIN;
+var ARRAY = binding.HEADER_ARRAY;
+
+function parse(type, message, cut) {
+  var parser = new HTTPParser(type);
+  var result = { headers: [], url: '', trailers: [], complete: false };
+
+  parser.onHeaders = function(headers, url) {
+    if (result.info) {
+      result.trailers = result.trailers.concat(headers);
+    } else {
+      result.headers = result.headers.concat(headers);
+    }
+    result.url += url;
+  };
+
+  parser.onHeadersComplete = function(info) {
+    result.info = info;
+    result.headers = result.headers.concat(info.headers);
+    if (info.url !== undefined) result.url += info.url;
+  };
+
+  parser.onMessageComplete = function() {
+    result.complete = true;
+  };
+
+  // Feed the message in pieces of `cut` bytes, each in its own buffer.
+  for (var i = 0; i < message.length; i += cut) {
+    var piece = new Buffer(message.slice(i, i + cut), 'binary');
+    var ret = parser.execute(piece, 0, piece.length);
+    assert.equal(piece.length, ret);
+  }
+  return result;
+}
+
+var request = 'GET /where?q=now HTTP/1.1\r\n' +
+              'Host: example.com\r\n' +
+              'X-Empty:\r\n' +
+              'Cookie: a=1\r\n' +
+              'cOOKIE: b=2\r\n' +
+              'Set-Cookie: c=3\r\n' +
+              'X-Forwarded-For: 10.0.0.1\r\n' +
+              'My-Own-Header: mine\r\n' +
+              '\r\n';
+
+[1, 2, 3, 7, request.length].forEach(function(cut) {
+  var r = parse('request', request, cut);
+  assert.ok(r.complete);
+  assert.equal('GET', r.info.method);
+  assert.equal(1, r.info.versionMajor);
+  assert.equal(1, r.info.versionMinor);
+  assert.equal('/where?q=now', r.url);
+  assert.deepEqual(['host', 'example.com', FIRST,
+                    'x-empty', '', JOIN,
+                    'cookie', 'a=1', JOIN,
+                    'cookie', 'b=2', JOIN,
+                    'set-cookie', 'c=3', ARRAY,
+                    'x-forwarded-for', '10.0.0.1', JOIN,
+                    'my-own-header', 'mine', FIRST], r.headers);
+});
+
+// More headers than the parser keeps at once come through onHeaders().
+var many = 'POST /many HTTP/1.0\r\n';
+var expected = [];
+for (var i = 0; i < 100; i++) {
+  many += 'X-Header-' + i + ': value ' + i + '\r\n';
+  expected.push('x-header-' + i, 'value ' + i, JOIN);
+}
+many += 'Content-Length: 0\r\n\r\n';
+expected.push('content-length', '0', FIRST);
+
+[5, many.length].forEach(function(cut) {
+  var r = parse('request', many, cut);
+  assert.ok(r.complete);
+  assert.equal('/many', r.url);
+  assert.deepEqual(expected, r.headers);
+});
+
+// Trailers arrive after onHeadersComplete.
+var response = 'HTTP/1.1 200 OK\r\n' +
+               'Transfer-Encoding: chunked\r\n' +
+               'Trailer: Content-MD5\r\n' +
+               '\r\n' +
+               '5\r\nhello\r\n' +
+               '0\r\n' +
+               'Content-MD5: abc\r\n' +
+               'X-Done: yes\r\n' +
+               '\r\n';
+
+[1, 4, response.length].forEach(function(cut) {
+  var r = parse('response', response, cut);
+  assert.ok(r.complete);
+  assert.equal(200, r.info.statusCode);
+  assert.equal(undefined, r.info.url);
+  assert.deepEqual(['transfer-encoding', 'chunked', FIRST,
+                    'trailer', 'Content-MD5', FIRST], r.headers);
+  assert.deepEqual(['content-md5', 'abc', FIRST,
+                    'x-done', 'yes', JOIN], r.trailers);
+});
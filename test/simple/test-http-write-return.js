@@ -0,0 +1,72 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// The connection is corked while a response writes, but small writes must
+// still report that they were accepted, and 'drain' only follows a write
+// that returned false.
+
+var common = require('../common');
+var assert = require('assert');
+var http = require('http');
+
+var small = new Array(100).join('x');
+var big = new Buffer(64 * 1024);
+var smallReturns = [];
+var bigReturn;
+var drains = 0;
+var received = 0;
+
+var server = http.createServer(function(req, res) {
+  res.writeHead(200, { 'Content-Type': 'text/plain' });
+
+  for (var i = 0; i < 10; i++) {
+    smallReturns.push(res.write(small));
+  }
+
+  res.on('drain', function() {
+    drains++;
+    res.end();
+  });
+
+  process.nextTick(function() {
+    assert.equal(drains, 0);
+    bigReturn = res.write(big);
+  });
+});
+
+server.listen(common.PORT, function() {
+  http.get({ port: common.PORT, path: '/' }, function(res) {
+    res.on('data', function(d) {
+      received += d.length;
+    });
+    res.on('end', function() {
+      server.close();
+    });
+  });
+});
+
+process.on('exit', function() {
+  assert.deepEqual(smallReturns, [true, true, true, true, true,
+                                  true, true, true, true, true]);
+  assert.equal(bigReturn, false);
+  assert.equal(drains, 1);
+  assert.equal(received, 10 * small.length + big.length);
+});
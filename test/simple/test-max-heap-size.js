@@ -0,0 +1,82 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var fs = require('fs');
+var path = require('path');
+var spawn = require('child_process').spawn;
+
+// A script that allocates without bound should hit --max-heap-size and
+// stop with a fatal error, rather than thrash or exit as if it succeeded.
+var leak = 'var a = []; for (var i = 0; ; i++) a.push({ i: i, s: "x" + i });';
+
+// The child writes straight to a file so nothing has to be read from a pipe.
+var runs = 0;
+function run(args, callback) {
+  var output = path.join(common.tmpDir, 'max-heap-size-' + (runs++) + '.txt');
+  var fd = fs.openSync(output, 'w');
+  var child = spawn(process.execPath, args, { customFds: [-1, fd, fd] });
+  child.on('exit', function(code) {
+    fs.closeSync(fd);
+    callback(code, fs.readFileSync(output, 'utf8'));
+    fs.unlinkSync(output);
+  });
+}
+
+var exited = 0;
+
+run(['--max-heap-size=16', '-e', leak], function(code, output) {
+  assert.equal(code, 1);
+  assert.ok(/FATAL ERROR:.*out of memory/i.test(output));
+  exited++;
+});
+
+run(['--max-heap-size=16', '--gc-mode=compartment', '-e', leak],
+    function(code, output) {
+      assert.equal(code, 1);
+      assert.ok(/FATAL ERROR:.*out of memory/i.test(output));
+      exited++;
+    });
+
+// A script that fits runs normally under the same limit.
+run(['--max-heap-size=16', '-e', 'console.log("fits")'],
+    function(code, output) {
+      assert.ok(/^fits$/m.test(output));
+      assert.ok(!/FATAL ERROR/.test(output));
+      exited++;
+    });
+
+run(['--max-heap-size=0', '-e', '1'], function(code, output) {
+  assert.equal(code, 1);
+  assert.ok(/--max-heap-size/.test(output));
+  exited++;
+});
+
+run(['--gc-mode=bogus', '-e', '1'], function(code, output) {
+  assert.equal(code, 1);
+  assert.ok(/--gc-mode/.test(output));
+  exited++;
+});
+
+process.on('exit', function() {
+  assert.equal(exited, 5);
+});
@@ -0,0 +1,76 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Connections that arrive together are accepted in batches. Each still
+// gets its own socket, and the peer's address is filled in on demand.
+
+var common = require('../common');
+var assert = require('assert');
+var net = require('net');
+
+var N = 200;
+var clientPorts = {};
+var serverPorts = {};
+var accepted = 0;
+var connected = 0;
+
+function maybeClose() {
+  if (accepted == N && connected == N) server.close();
+}
+
+var server = net.createServer(function(s) {
+  accepted++;
+  assert.equal(s.remoteAddress, '127.0.0.1');
+  assert.equal(s.remoteAddress, '127.0.0.1');
+  serverPorts[s.remotePort] = true;
+  s.end();
+  maybeClose();
+});
+
+server.listen(common.PORT, '127.0.0.1', function() {
+  for (var i = 0; i < N; i++) {
+    var c = net.createConnection(common.PORT, '127.0.0.1');
+    c.on('connect', function() {
+      clientPorts[this.address().port] = true;
+      connected++;
+      maybeClose();
+    });
+  }
+});
+
+// The binding only fills whole records of an Int32Array.
+var binding = process.binding('net');
+assert.throws(function() {
+  binding.acceptMany(0, new Uint8Array(64 * binding.peerStride));
+}, TypeError);
+assert.throws(function() {
+  binding.acceptMany(0, new Int32Array(binding.peerStride - 1));
+}, TypeError);
+
+var overwritten = new net.Socket();
+overwritten.remoteAddress = 'somewhere';
+assert.equal(overwritten.remoteAddress, 'somewhere');
+
+process.on('exit', function() {
+  assert.equal(accepted, N);
+  assert.deepEqual(Object.keys(serverPorts).sort(),
+                   Object.keys(clientPorts).sort());
+});
@@ -0,0 +1,81 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Two servers with reusePort can listen on the same port, and between them
+// they get every connection.  A third without it still gets EADDRINUSE.
+
+var common = require('../common');
+var assert = require('assert');
+var net = require('net');
+
+if (!process.binding('net').setReusePort ||
+    process.platform == 'win32') {
+  console.error('Skipping: no SO_REUSEPORT');
+  process.exit(0);
+}
+
+var N = 100;
+var accepted = [0, 0];
+var connected = 0;
+var gotError = false;
+var listening = 0;
+
+var servers = [0, 1].map(function(i) {
+  var server = net.createServer({ reusePort: true }, function(socket) {
+    accepted[i]++;
+    socket.end();
+    if (accepted[0] + accepted[1] == N) {
+      servers.forEach(function(s) { s.close(); });
+    }
+  });
+  server.listen(common.PORT, '127.0.0.1', function() {
+    if (++listening == 2) tryPlain();
+  });
+  return server;
+});
+
+function tryPlain() {
+  var plain = net.createServer();
+  plain.on('error', function(e) {
+    assert.ok(e.message.indexOf('EADDRINUSE') >= 0);
+    gotError = true;
+    connectAll();
+  });
+  plain.listen(common.PORT, '127.0.0.1', function() {
+    assert.fail('listened without reusePort');
+  });
+}
+
+function connectAll() {
+  for (var i = 0; i < N; i++) {
+    var c = net.createConnection(common.PORT, '127.0.0.1');
+    c.on('connect', function() {
+      connected++;
+    });
+  }
+}
+
+process.on('exit', function() {
+  assert.ok(gotError);
+  assert.equal(N, connected);
+  assert.equal(N, accepted[0] + accepted[1]);
+  console.log('accepted: %d / %d', accepted[0], accepted[1]);
+});
@@ -0,0 +1,76 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+// Writes queued while connecting are flushed with writev(2). Queue more
+// chunks than one writev call takes and more bytes than the socket takes at
+// once, so the flush has to batch and resume after short writes.
+
+var common = require('../common');
+var assert = require('assert');
+var net = require('net');
+var fs = require('fs');
+var path = require('path');
+
+var CHUNKS = 1500;
+var file = path.join(common.tmpDir, 'net-writev.txt');
+var fd = fs.openSync(file, 'w');
+var expected = [];
+var callbacks = 0;
+
+var server = net.createServer(function(socket) {
+  // Let the client's writes back up first.
+  socket.pause();
+  setTimeout(function() {
+    socket.resume();
+  }, 200);
+
+  socket.on('data', function(d) {
+    fs.writeSync(fd, d, 0, d.length, null);
+  });
+  socket.on('end', function() {
+    fs.closeSync(fd);
+    server.close();
+  });
+});
+
+server.listen(common.PORT, function() {
+  var client = net.createConnection(common.PORT);
+  var big = new Array(128 * 1024).join('y');
+
+  for (var i = 0; i < CHUNKS; i++) {
+    var s = i + ':' + (i % 50 ? new Array(i % 400 + 1).join('x') : big) + '\n';
+    expected.push(s);
+    var data = i % 2 ? new Buffer(s, 'ascii') : s;
+    client.write(data, function() {
+      callbacks++;
+    });
+  }
+
+  client.on('drain', function() {
+    client.end();
+  });
+});
+
+process.on('exit', function() {
+  assert.equal(fs.readFileSync(file, 'ascii'), expected.join(''));
+  assert.equal(callbacks, CHUNKS);
+  fs.unlinkSync(file);
+});
@@ -0,0 +1,71 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var vm = require('vm');
+
+common.globalCheck = false;
+
+common.debug('reads go through to the sandbox');
+var sandbox = { count: 2, escape: 'mine', obj: { n: 1 } };
+assert.equal(3, vm.runInSandbox('count + 1', sandbox));
+assert.equal('mine', vm.runInSandbox('escape', sandbox));
+assert.equal('function', vm.runInSandbox('typeof unescape', sandbox));
+
+common.debug('assignments are copied back');
+vm.runInSandbox('count += 1; name = "kitty"; obj.n++; self = this', sandbox);
+assert.equal(3, sandbox.count);
+assert.equal('kitty', sandbox.name);
+assert.equal(2, sandbox.obj.n);
+assert.strictEqual(sandbox, sandbox.self);
+assert.deepEqual(['count', 'escape', 'obj', 'name', 'self'],
+                 Object.keys(sandbox));
+
+common.debug('builtins are not copied back');
+sandbox = {};
+vm.runInSandbox('Array; Math.max(1, 2); JSON.stringify({})', sandbox);
+assert.deepEqual([], Object.keys(sandbox));
+
+common.debug('nothing leaks into this context');
+vm.runInSandbox('leaked = 1');
+assert.equal('undefined', typeof leaked);
+assert.equal('undefined', vm.runInSandbox('typeof require'));
+
+common.debug('errors propagate');
+assert.throws(function() {
+  vm.runInSandbox('throw new Error("test")', {});
+}, /test/);
+
+common.debug('precompiled script');
+var script = new vm.Script('sum = a + b');
+sandbox = { a: 1, b: 2 };
+script.runInSandbox(sandbox);
+assert.equal(3, sandbox.sum);
+sandbox.a = 10;
+script.runInSandbox(sandbox);
+assert.equal(12, sandbox.sum);
+
+common.debug('matches runInNewContext');
+var code = 'var out = []; for (var i = 0; i < n; i++) out.push(i * 2); ' +
+           'out.join()';
+assert.equal(vm.runInNewContext(code, { n: 5 }),
+             vm.runInSandbox(code, { n: 5 }));
@@ -0,0 +1,74 @@
+// Copyright Joyent, Inc. and other Node contributors.
+//
+// Permission is hereby granted, free of charge, to any person obtaining a
+// copy of this software and associated documentation files (the
+// "Software"), to deal in the Software without restriction, including
+// without limitation the rights to use, copy, modify, merge, publish,
+// distribute, sublicense, and/or sell copies of the Software, and to permit
+// persons to whom the Software is furnished to do so, subject to the
+// following conditions:
+//
+// The above copyright notice and this permission notice shall be included
+// in all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+// OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+// MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN
+// NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+// DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR
+// OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE
+// USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+var common = require('../common');
+var assert = require('assert');
+var path = require('path');
+var Worker = require('worker').Worker;
+
+var messages = [];
+var errors = [];
+var exited = false;
+
+var worker = new Worker(path.join(common.fixturesDir, 'worker.js'));
+
+worker.on('message', function(data) {
+  messages.push(data);
+});
+
+worker.on('error', function(err) {
+  errors.push(err.message);
+});
+
+worker.on('exit', function() {
+  exited = true;
+  assert.throws(function() { worker.postMessage('late'); });
+});
+
+worker.postMessage({ n: 1, list: [1, 'two'], when: new Date(0) });
+worker.postMessage('throw');
+worker.postMessage('close');
+
+common.debug('functions cannot be cloned');
+assert.throws(function() { worker.postMessage(function() {}); }, TypeError);
+
+// A worker that never closes is stopped by terminate().
+var idle = new Worker(path.join(common.fixturesDir, 'worker.js'));
+var idleExited = false;
+idle.on('message', function(data) {
+  assert.equal('ready', data);
+  idle.terminate();
+});
+idle.on('exit', function() {
+  idleExited = true;
+});
+
+process.on('exit', function() {
+  assert.ok(exited);
+  assert.ok(idleExited);
+  assert.equal(3, messages.length);
+  assert.equal('ready', messages[0]);
+  assert.deepEqual({ n: 1, list: [1, 'two'], when: new Date(0) },
+                   messages[1].echo);
+  assert.ok(messages[1].echo.when instanceof Date);
+  assert.deepEqual({ received: 3 }, messages[2]);
+  assert.deepEqual(['Error: thrown in worker'], errors);
+});
@@ -0,0 +1,142 @@
+#!/usr/bin/env python
+#
+# Generates src/node_http_headers.h, the table of common header names the
+# http_parser binding hands to javascript as interned lowercase strings.
+#
+#   python tools/gen_http_headers.py > src/node_http_headers.h
+#
+# It searches for multipliers that give each name its own slot, so a lookup
+# is one hash and at most one comparison.
+
+import sys
+
+# How a second header of the same name is treated.  Matches HeaderPolicy in
+# the generated file and _addHeaderLine() in lib/http.js.
+FIRST = 'HEADER_FIRST'  # the first one wins
+JOIN = 'HEADER_JOIN'    # joined with ', '
+ARRAY = 'HEADER_ARRAY'  # collected in an array
+
+HEADERS = [
+  ('accept', JOIN),
+  ('accept-charset', JOIN),
+  ('accept-encoding', JOIN),
+  ('accept-language', JOIN),
+  ('accept-ranges', FIRST),
+  ('access-control-allow-origin', FIRST),
+  ('age', FIRST),
+  ('allow', FIRST),
+  ('authorization', FIRST),
+  ('cache-control', FIRST),
+  ('connection', JOIN),
+  ('content-disposition', FIRST),
+  ('content-encoding', FIRST),
+  ('content-language', FIRST),
+  ('content-length', FIRST),
+  ('content-location', FIRST),
+  ('content-md5', FIRST),
+  ('content-range', FIRST),
+  ('content-type', FIRST),
+  ('cookie', JOIN),
+  ('date', FIRST),
+  ('dnt', FIRST),
+  ('etag', FIRST),
+  ('expect', FIRST),
+  ('expires', FIRST),
+  ('from', FIRST),
+  ('host', FIRST),
+  ('if-match', FIRST),
+  ('if-modified-since', FIRST),
+  ('if-none-match', FIRST),
+  ('if-range', FIRST),
+  ('if-unmodified-since', FIRST),
+  ('keep-alive', FIRST),
+  ('last-modified', FIRST),
+  ('link', FIRST),
+  ('location', FIRST),
+  ('max-forwards', FIRST),
+  ('origin', FIRST),
+  ('pragma', JOIN),
+  ('proxy-authenticate', FIRST),
+  ('proxy-authorization', FIRST),
+  ('proxy-connection', FIRST),
+  ('range', FIRST),
+  ('referer', FIRST),
+  ('refresh', FIRST),
+  ('retry-after', FIRST),
+  ('server', FIRST),
+  ('set-cookie', ARRAY),
+  ('status', FIRST),
+  ('strict-transport-security', FIRST),
+  ('te', FIRST),
+  ('trailer', FIRST),
+  ('transfer-encoding', FIRST),
+  ('upgrade', FIRST),
+  ('user-agent', FIRST),
+  ('vary', FIRST),
+  ('via', FIRST),
+  ('warning', FIRST),
+  ('www-authenticate', FIRST),
+  ('x-forwarded-for', JOIN),
+  ('x-forwarded-host', JOIN),
+  ('x-forwarded-proto', JOIN),
+  ('x-powered-by', JOIN),
+  ('x-real-ip', JOIN),
+  ('x-requested-with', JOIN),
+]
+
+SLOTS = 256
+
+
+# Must match HeaderHash() in the generated file.
+def hash(name, k):
+  n = len(name)
+  return (n * k[0] + ord(name[0]) * k[1] + ord(name[n - 1]) * k[2] +
+          ord(name[n // 2]) * k[3]) % SLOTS
+
+
+def search():
+  for k0 in range(1, 64):
+    for k1 in range(1, 64):
+      for k2 in range(1, 64):
+        for k3 in range(0, 16):
+          k = (k0, k1, k2, k3)
+          slots = set(hash(name, k) for name, _ in HEADERS)
+          if len(slots) == len(HEADERS):
+            return k
+  raise Exception('no perfect hash found; try more slots')
+
+
+def main():
+  k = search()
+  table = ['  { NULL, 0, HEADER_FIRST },'] * SLOTS
+  for name, policy in HEADERS:
+    table[hash(name, k)] = '  { "%s", %d, %s },' % (name, len(name), policy)
+
+  out = sys.stdout
+  out.write('// Generated by tools/gen_http_headers.py.  Do not edit.\n\n')
+  out.write('#ifndef NODE_HTTP_HEADERS_H_\n#define NODE_HTTP_HEADERS_H_\n\n')
+  out.write('#include <stddef.h>\n\n')
+  out.write('namespace node {\n\n')
+  out.write('enum HeaderPolicy { HEADER_FIRST, HEADER_JOIN, HEADER_ARRAY };\n\n')
+  out.write('struct KnownHeader {\n')
+  out.write('  const char *name;\n')
+  out.write('  size_t length;\n')
+  out.write('  HeaderPolicy policy;\n')
+  out.write('};\n\n')
+  out.write('static const int kKnownHeaderSlots = %d;\n\n' % SLOTS)
+  out.write('// Takes the header name lowercased.\n')
+  out.write('static inline unsigned HeaderHash(const char *name, size_t n) {\n')
+  out.write('  const unsigned char *s = ' +
+            'reinterpret_cast<const unsigned char*>(name);\n')
+  out.write('  return (n * %d + s[0] * %d + s[n - 1] * %d + s[n / 2] * %d) %%\n'
+            % k)
+  out.write('         kKnownHeaderSlots;\n')
+  out.write('}\n\n')
+  out.write('static const KnownHeader kKnownHeaders[kKnownHeaderSlots] = {\n')
+  out.write('\n'.join(table))
+  out.write('\n};\n\n')
+  out.write('}  // namespace node\n\n#endif  // NODE_HTTP_HEADERS_H_\n')
+
+
+if __name__ == '__main__':
+  main()
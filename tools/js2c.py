@@ -215,11 +215,19 @@ HEADER_TEMPLATE = """\
 #define node_natives_h
 namespace node {
 
+// SpiderMonkey strings are always two-byte, so the sources are stored that
+// way and handed to the engine as external strings without a copy.
+#ifdef MOZILLA_JS
+typedef uint16_t native_char;
+#else
+typedef char native_char;
+#endif
+
 %(source_lines)s\
 
 struct _native {
   const char* name;
-  const char* source;
+  const native_char* source;
   size_t source_len;
 };
 
@@ -237,11 +245,11 @@ static const struct _native natives[] = {
 
 
 NATIVE_DECLARATION = """\
-  { "%(id)s", %(id)s_native, sizeof(%(id)s_native)-1 },
+  { "%(id)s", %(id)s_native, sizeof(%(id)s_native)/sizeof(native_char)-1 },
 """
 
 SOURCE_DECLARATION = """\
-  const char %(id)s_native[] = { %(data)s };
+  const native_char %(id)s_native[] = { %(data)s };
 """
 
 
@@ -0,0 +1,26 @@
+// Compiles every builtin module, and src/node.js, and writes the bytecode
+// out as a C++ source file.  Run at build time by node_mksnapshot:
+//
+//   node_mksnapshot tools/natives_snapshot.js src/node_natives_snapshot.cc
+//
+// Each builtin is wrapped and named exactly the way NativeModule compiles
+// it, since node only uses a snapshot whose filename and source both match.
+
+var natives = process.binding('natives');
+var evals = process.binding('evals');
+var wrap = require('module').wrap;
+
+var out = process.argv[2];
+if (!out) {
+  console.error('usage: node_mksnapshot natives_snapshot.js <output.cc>');
+  process.exit(1);
+}
+
+var filenames = [];
+var sources = [];
+Object.keys(natives).sort().forEach(function(id) {
+  filenames.push(id + '.js');
+  sources.push(wrap(natives[id]));
+});
+
+evals.writeNativesSnapshot(out, filenames, sources);